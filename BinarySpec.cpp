@@ -0,0 +1,207 @@
+//
+//  BinarySpec.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "BinarySpec.h"
+#include "LittleEndian.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = {'\x89', 'R', 'G', 'S', 'P', 'E', 'C', '\n'};
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// byte offsets of the header fields
+enum
+{
+    MAGIC_AT = 0,
+    VERSION_AT = 8,
+    BYTE_ORDER_AT = 12,
+    FID_SIZE_AT = 16,
+    NLINES_AT = 24,
+    DWELL_AT = 32,
+    PRE_DELAY_AT = 40,
+    COLUMN_BYTES_AT = 48
+};
+
+// bytes of each column of nlines values, padded
+static uint64_t columnBytes(uint64_t nlines)
+{
+    const uint64_t alignment = BinarySpec::COLUMN_ALIGNMENT;
+    return (nlines * sizeof(float) + alignment - 1) / alignment * alignment;
+}
+
+BinarySpec::BinarySpec(const std::string& name)
+    : mName(name), mMap(0), mLength(0), mFidSize(0), mNLines(0), mDwell(0.0),
+      mPreDelay(0.0), mColumnBytes(0)
+{
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open file: " + name + "\n" + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < HEADER_BYTES)
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a binary spec file: " + name);
+    }
+
+    mLength = size_t(st.st_size);
+    void *map = mmap(0, mLength, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("Unable to map file: " + name + "\n" + strerror(errno));
+    mMap = static_cast<const unsigned char *>(map);
+
+    const unsigned char *h = mMap;
+    if (std::memcmp(h + MAGIC_AT, MAGIC, sizeof(MAGIC)) != 0
+        || get32(h + BYTE_ORDER_AT) != BYTE_ORDER_MARK
+        || get32(h + VERSION_AT) != VERSION)
+    {
+        munmap(const_cast<unsigned char *>(mMap), mLength);
+        throw std::runtime_error("Not a binary spec file of version 1: " + name);
+    }
+
+    const uint64_t fidSize = get64(h + FID_SIZE_AT);
+    const uint64_t nlines = get64(h + NLINES_AT);
+    mDwell = getDouble(h + DWELL_AT);
+    mPreDelay = getDouble(h + PRE_DELAY_AT);
+    mColumnBytes = get64(h + COLUMN_BYTES_AT);
+
+    if (fidSize > uint64_t(std::numeric_limits<long>::max())
+        || nlines > (mLength - HEADER_BYTES) / sizeof(float)
+        || mColumnBytes != columnBytes(nlines)
+        || HEADER_BYTES + 4 * mColumnBytes > mLength)
+    {
+        munmap(const_cast<unsigned char *>(mMap), mLength);
+        throw std::runtime_error("Damaged binary spec file: " + name);
+    }
+    mFidSize = long(fidSize);
+    mNLines = size_t(nlines);
+
+    madvise(const_cast<unsigned char *>(mMap), mLength, MADV_WILLNEED);
+
+    if (!littleEndianHost())
+    {
+        mHostColumns.resize(4 * mNLines);
+        for (int n = 0; n < 4; n++)
+            copyFloats(&mHostColumns[n * mNLines], mMap + HEADER_BYTES + n * mColumnBytes,
+                       mNLines);
+    }
+}
+
+BinarySpec::~BinarySpec()
+{
+    munmap(const_cast<unsigned char *>(mMap), mLength);
+}
+
+bool BinarySpec::isBinary(const std::string& name)
+{
+    std::ifstream is(name, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return is.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void BinarySpec::write(const std::string& name, long fidSize, double dwell, double preDelay,
+                       size_t nlines, const float *amplitude, const float *freq,
+                       const float *damp, const float *phase)
+{
+    std::ofstream os(name, std::ios::binary | std::ios::trunc);
+    if (!os)
+        throw std::runtime_error("Unable to open file: " + name);
+
+    const uint64_t bytes = columnBytes(nlines);
+
+    unsigned char h[HEADER_BYTES] = {};
+    std::memcpy(h + MAGIC_AT, MAGIC, sizeof(MAGIC));
+    put32(h + VERSION_AT, VERSION);
+    put32(h + BYTE_ORDER_AT, BYTE_ORDER_MARK);
+    put64(h + FID_SIZE_AT, uint64_t(fidSize));
+    put64(h + NLINES_AT, nlines);
+    putDouble(h + DWELL_AT, dwell);
+    putDouble(h + PRE_DELAY_AT, preDelay);
+    put64(h + COLUMN_BYTES_AT, bytes);
+    os.write(reinterpret_cast<const char *>(h), HEADER_BYTES);
+
+    std::vector<char> column(bytes, 0);
+    for (const float *values : {amplitude, freq, damp, phase})
+    {
+        copyFloats(column.data(), values, nlines);
+        os.write(column.data(), column.size());
+    }
+
+    os.close();
+    if (!os)
+        throw std::runtime_error("Unable to write to file: " + name);
+}
+
+long BinarySpec::fidSize() const
+{
+    return mFidSize;
+}
+
+size_t BinarySpec::nLines() const
+{
+    return mNLines;
+}
+
+double BinarySpec::dwell() const
+{
+    return mDwell;
+}
+
+double BinarySpec::preDelay() const
+{
+    return mPreDelay;
+}
+
+const float *BinarySpec::column(int n) const
+{
+    if (!mHostColumns.empty())
+        return &mHostColumns[n * mNLines];
+    return reinterpret_cast<const float *>(mMap + HEADER_BYTES + n * mColumnBytes);
+}
+
+const float *BinarySpec::amplitude() const
+{
+    return column(0);
+}
+
+const float *BinarySpec::freq() const
+{
+    return column(1);
+}
+
+const float *BinarySpec::damp() const
+{
+    return column(2);
+}
+
+const float *BinarySpec::phase() const
+{
+    return column(3);
+}
@@ -0,0 +1,96 @@
+//
+//  BinarySpec.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BINARYSPEC_H
+#define BINARYSPEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* The binary spec format: the contents of a text spec file (see SpecFile)
+   for line lists made by other programs, which can be mapped and used
+   without parsing or copying.
+
+   Every field is little-endian whatever the host.  The file is
+
+     header       HEADER_BYTES bytes, fields at the offsets in BinarySpec.cpp
+     columns      amplitude, frequency, damping and phase, each nLines()
+                  float32 values padded to a multiple of COLUMN_ALIGNMENT
+                  bytes
+
+   The header starts with the magic "\x89RGSPEC\n", the format version and
+   a byte order mark, and holds the FID size, the number of lines, the
+   dwell and the pre-acquisition delay.  As the map starts on a page
+   boundary every column starts on a COLUMN_ALIGNMENT byte boundary.
+
+   On little-endian hosts the column accessors point into the map, which
+   lasts as long as the object; elsewhere the columns are copied once into
+   host order.  Errors throw std::runtime_error. */
+class BinarySpec
+{
+public:
+    enum
+    {
+        VERSION = 1,
+        HEADER_BYTES = 64,
+        COLUMN_ALIGNMENT = 64
+    };
+
+    explicit BinarySpec(const std::string& name);
+    ~BinarySpec();
+
+    BinarySpec(const BinarySpec&) = delete;
+    BinarySpec& operator=(const BinarySpec&) = delete;
+
+    // true if the file exists and starts with the magic of the binary format
+    static bool isBinary(const std::string& name);
+
+    /* Writes a binary spec file with nlines lines from the arrays,
+       replacing any file of that name. */
+    static void write(const std::string& name, long fidSize, double dwell, double preDelay,
+                      size_t nlines, const float *amplitude, const float *freq,
+                      const float *damp, const float *phase);
+
+    long fidSize() const;
+    size_t nLines() const;
+    double dwell() const;
+    double preDelay() const;
+
+    const float *amplitude() const;
+    const float *freq() const;
+    const float *damp() const;
+    const float *phase() const;
+
+private:
+    const float *column(int n) const;
+
+    std::string mName;
+    const unsigned char *mMap;
+    size_t mLength;
+    long mFidSize;
+    size_t mNLines;
+    double mDwell;
+    double mPreDelay;
+    uint64_t mColumnBytes;
+    std::vector<float> mHostColumns;    // big-endian hosts only
+};
+
+#endif // BINARYSPEC_H
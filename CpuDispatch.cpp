@@ -0,0 +1,104 @@
+//
+//  CpuDispatch.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "CpuDispatch.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+// -1 until the first call of active() or select()
+std::atomic<int> CpuDispatch::sActive(-1);
+
+CpuDispatch::Isa CpuDispatch::detected()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    // these also check that the operating system saves the vector registers
+    __builtin_cpu_init();
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+        && __builtin_cpu_supports("f16c");
+    if (avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+        return AVX512;
+    if (avx2)
+        return AVX2;
+#endif
+    return BASELINE;
+}
+
+CpuDispatch::Isa CpuDispatch::active()
+{
+    int isa = sActive.load(std::memory_order_relaxed);
+    if (isa < 0)
+    {
+        isa = detected();
+        sActive.store(isa, std::memory_order_relaxed);
+    }
+    return Isa(isa);
+}
+
+void CpuDispatch::select(Isa isa)
+{
+    if (!supported(isa))
+        throw std::invalid_argument(std::string("This CPU cannot run the ") + name(isa)
+                                    + " kernels");
+    sActive.store(isa, std::memory_order_relaxed);
+}
+
+bool CpuDispatch::supported(Isa isa)
+{
+    return isa >= BASELINE && isa <= detected();
+}
+
+unsigned CpuDispatch::lanes(Isa isa)
+{
+    static const unsigned LANES[NISAS] = {4, 8, 16};
+    return LANES[isa];
+}
+
+const char *CpuDispatch::name(Isa isa)
+{
+    static const char *const NAMES[NISAS] = {"baseline", "avx2", "avx512"};
+    return NAMES[isa];
+}
+
+CpuDispatch::Isa CpuDispatch::isa(const std::string& name)
+{
+    for (int isa = 0; isa < NISAS; isa++)
+    {
+        if (name == CpuDispatch::name(Isa(isa)))
+            return Isa(isa);
+    }
+    throw std::invalid_argument("Unknown instruction set: " + name
+                                + " (baseline, avx2 or avx512)");
+}
+
+void CpuDispatch::setupFromEnvironment()
+{
+    const char *wanted = std::getenv("NMRSIM_ISA");
+    if (wanted != nullptr && *wanted != '\0')
+        select(isa(wanted));
+}
+
+std::string CpuDispatch::description()
+{
+    const Isa isa = active();
+    return std::string("kernels: ") + name(isa) + " (" + std::to_string(lanes(isa))
+        + " lanes), detected " + name(detected());
+}
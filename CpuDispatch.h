@@ -0,0 +1,79 @@
+//
+//  CpuDispatch.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+
+#include <atomic>
+#include <string>
+
+/* The instruction sets the kernels of Kernels.h are compiled for, and the
+   choice of one of them for the run.  The program itself is built for the
+   x86-64 baseline so that one binary runs on every node; the sums of
+   DecayKernel, the deviates of GaussianNoise and the sample conversions of
+   RangerWriter are compiled again for AVX2 and for AVX-512
+   (KernelsAvx2.cpp and KernelsAvx512.cpp) and the widest one the CPU and
+   operating system support is used.
+
+   Set NMRSIM_ISA to baseline, avx2 or avx512 to use another, e.g. to
+   compare them on one machine; one the CPU lacks is an error rather than
+   a crash.  Off x86 only the baseline is used. */
+class CpuDispatch
+{
+public:
+    enum Isa
+    {
+        BASELINE,       // SSE2 (generic vectors off x86), 4 float lanes
+        AVX2,           // AVX2, FMA and F16C, 8 float lanes
+        AVX512,         // AVX-512 F, DQ, BW and VL as well, 16 float lanes
+        NISAS
+    };
+
+    // the widest instruction set the CPU and operating system support
+    static Isa detected();
+
+    // the instruction set in use: detected() unless another has been selected
+    static Isa active();
+
+    // uses isa from now on; throws std::invalid_argument if the CPU lacks it
+    static void select(Isa isa);
+
+    static bool supported(Isa isa);
+
+    // floats in a vector of isa
+    static unsigned lanes(Isa isa);
+
+    // "baseline", "avx2" or "avx512"
+    static const char *name(Isa isa);
+
+    // the instruction set of a name(); throws std::invalid_argument if none has it
+    static Isa isa(const std::string& name);
+
+    // selects the instruction set named by NMRSIM_ISA, if it is set
+    static void setupFromEnvironment();
+
+    // a line for the log, e.g. "kernels: avx2 (8 lanes), detected avx512"
+    static std::string description();
+
+private:
+    static std::atomic<int> sActive;
+};
+
+#endif // CPUDISPATCH_H
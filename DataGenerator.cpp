@@ -19,67 +19,97 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "DataGenerator.h"
-#include "DataGenerator.h"
+#include "BinarySpec.h"
+#include "DecayKernel.h"
+#include "GaussianNoise.h"
+#include "Gnuplot.h"
+#include "Instrument.h"
+#include "NufftSynth.h"
+#include "Parallel.h"
+#include "Philox.h"
 #include "ProNmr.h"
-
+#include "ProNmrMap.h"
+#include "RangerFile.h"
+#include "SpecFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
 #include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
 
 DataGenerator::DataGenerator(const InputSpecs& specs)
-    : mSpecs(specs)
+    : mSpecs(specs), mSynthesisMode(PHASOR), mPrecision(SINGLE_PRECISION),
+      mStorage(RangerFile::FLOAT32), mSynthesisEngine(AUTOMATIC),
+      mNufftTolerance(1.0e-6), mThreads(hardwareThreads()),
+      mSeed(1), mSpectrum(0), mPosition(0),
+      mNoiseTable({{0.00, 1}, {0.01, 1}, {0.02, 1}, {0.04, 1}, {0.08, 1},
+                   {0.16, 1}, {0.32, 1}, {0.64, 1}, {1.28, 1}, {2.56, 1}}),
+      mSynthesisRate(0.0)
 {
 }
 
-DataGenerator::InputSpecs::InputSpecs(DataGenerator::OutputFormat format, const std::string& fName)
-    : mFormat(format), mFName(fName)
+DataGenerator::DataGenerator()
+    : DataGenerator(InputSpecs(NONE, ""))
 {
+}
 
+DataGenerator::InputSpecs::InputSpecs(DataGenerator::OutputFormat format, const std::string& fName)
+    : mFormat(format), mFName(fName), mFidSize(0), mNLines(0), mDwell(0.0), mPreDelay(0.0)
+{
 }
 
 DataGenerator::InputSpecs::InputSpecs(const DataGenerator::InputSpecs& specs)
-    : mSpecs(specs)
+    : mFormat(specs.mFormat), mFName(specs.mFName), mFidSize(specs.mFidSize),
+      mNLines(specs.mNLines), mDwell(specs.mDwell), mPreDelay(specs.mPreDelay),
+      mAmplitude(specs.mAmplitude), mFreq(specs.mFreq), mDamp(specs.mDamp),
+      mPhase(specs.mPhase), mBinary(specs.mBinary)
 {
 }
 
 void DataGenerator::InputSpecs::read()
 {
-    try
-    {
-        std::ifstream is(mFName, std::ios::);
-        is.exceptions(std::ifstream::failbit);
-    }
-    catch (std::ios_base::failure& fail)
-    {
-        std::cerr << "Unable to open file: " << mFName
-                  << "\n" << fail.what() << std::endl;
-        throw;
-    }
+    ScopedTimer timer(Instrument::PARSE);
+    mAmplitude.clear();
+    mFreq.clear();
+    mDamp.clear();
+    mPhase.clear();
+    mBinary.reset();
 
-    try
+    if (BinarySpec::isBinary(mFName))
     {
-        // get the single parameters: dwell then de
-        is >> mFidSize >> mDwell >> mPreDelay;
-
-        mNLines = 0;
-        while (is)
-        {
-            float amplitude, freq, damp,  phase;
-            // check return value to deal with whitespace at end of file
-            is << amplitude << freq << damp << phase;
-            mAmplitude.push_back(amplitude);
-            mFreq.push_back(freq);
-            mDamp.push_back(damp);
-            mPhase.push_back(phase);
-            mNLines++;
-        }
+        std::shared_ptr<BinarySpec> binary = std::make_shared<BinarySpec>(mFName);
+        if (binary->fidSize() > std::numeric_limits<int>::max()
+            || binary->nLines() > size_t(std::numeric_limits<int>::max()))
+            throw std::runtime_error(mFName + ": FID size or line count out of range");
+        mFidSize = int(binary->fidSize());
+        mNLines = int(binary->nLines());
+        mDwell = float(binary->dwell());
+        mPreDelay = float(binary->preDelay());
+        mBinary = binary;
+        Instrument::count(Instrument::LINES_PROCESSED, binary->nLines());
+        return;
     }
 
-    catch (std::ios_base::failure& fail)
-    {
-        std::cerr << "Failure reading file: " << mFName
-                  << "\n" << fail.what() << std::endl;
-        throw;
-    }
+    SpecFile file(mFName);
+
+    // get the single parameters: fid size, dwell then de
+    const long fidSize = file.readLong("the FID size");
+    if (fidSize < 0 || fidSize > std::numeric_limits<int>::max())
+        throw std::runtime_error(mFName + ": FID size out of range: " + std::to_string(fidSize));
+    mFidSize = int(fidSize);
+    mDwell = file.readFloat("the dwell");
+    mPreDelay = file.readFloat("the pre-acquisition delay");
+    mNLines = int(file.readLines(mAmplitude, mFreq, mDamp, mPhase));
+    Instrument::count(Instrument::LINES_PROCESSED, mNLines);
 }
 
 void DataGenerator::InputSpecs::init()
@@ -94,6 +124,12 @@ void DataGenerator::InputSpecs::init()
     mFreq.clear();
     mDamp.clear();
     mPhase.clear();
+    mBinary.reset();
+}
+
+DataGenerator::OutputFormat DataGenerator::InputSpecs::format() const
+{
+    return mFormat;
 }
 
 std::string DataGenerator::InputSpecs::fName() const
@@ -121,32 +157,27 @@ float DataGenerator::InputSpecs::preDelay() const
     return mPreDelay;
 }
 
-float DataGenerator::InputSpecs::amplitude() const
+const float *DataGenerator::InputSpecs::amplitude() const
 {
-    return mAmplitude;
+    return mBinary ? mBinary->amplitude() : mAmplitude.data();
 }
 
-float DataGenerator::InputSpecs::freq() const
+const float *DataGenerator::InputSpecs::freq() const
 {
-    return mFreq;
+    return mBinary ? mBinary->freq() : mFreq.data();
 }
 
-float DataGenerator::InputSpecs::damp() const
+const float *DataGenerator::InputSpecs::damp() const
 {
-    return mDamp
+    return mBinary ? mBinary->damp() : mDamp.data();
 }
 
-float DataGenerator::InputSpecs::phase() const
+const float *DataGenerator::InputSpecs::phase() const
 {
-    return mPhase;
+    return mBinary ? mBinary->phase() : mPhase.data();
 }
 
 
-DataGenerator::DataGenerator(const DataGenerator::InputSpecs& specs)
-{
-
-}
-
 void DataGenerator::generate()
 {
     if (mSpecs.format() == PRONMR)
@@ -161,7 +192,18 @@ void DataGenerator::generate()
         return;
     }
 
-    throw std::invalid_argument("Invalid format specification." << "");
+    throw std::invalid_argument("Invalid format specification.");
+}
+
+// names under data/ start with the spec file's name without directories or extension
+static std::string outputRoot(const std::string& fName)
+{
+    std::string::size_type slash = fName.find_last_of('/');
+    std::string root = slash == std::string::npos ? fName : fName.substr(slash + 1);
+    std::string::size_type dot = root.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        root.erase(dot);
+    return root;
 }
 
 void DataGenerator::generateProNmrFid()
@@ -172,356 +214,910 @@ void DataGenerator::generateProNmrFid()
 
     std::cout << "Read " << mSpecs.nLines() << " peaks." << std::endl;
 
+    // si counts floats, two per complex point
+    if (mSpecs.fidSize() > MAXSIZE / 2)
+        throw std::invalid_argument("ProNmr files hold at most " + std::to_string(MAXSIZE / 2)
+                                    + " points; use the RANGER format for longer FIDs.");
+
+    // the header describes the spec's FID, one spectrum per file
+    fileInfo.si = fileInfo.td = 2 * mSpecs.fidSize();
+    fileInfo.dw = mSpecs.dwell();
+    fileInfo.de = mSpecs.preDelay();
+    fileInfo.nrecs = 1;
+
     // make some complex fids
     ComplexfArray ComplexFid(mSpecs.fidSize());
 
     // Generate FID
     makeSimFid(ComplexFid, mSpecs.nLines(), mSpecs.dwell(), mSpecs.amplitude(),
-               mSpecs.freq(), mSpecs.damp(), mSpecs.phase(), mSpecs.dwell(), true);
+               mSpecs.freq(), mSpecs.damp(), mSpecs.phase(), mSpecs.preDelay(), true);
 
-        // Add the required noise
-        addNoise(ComplexFid, pNoise[iSpec]);
+    std::cout << "Synthesis: " << synthesisRate() << " samples*lines/s" << std::endl;
+
+    /* every noise level and replicate is added to a copy of the one noiseless
+       FID and formatted on the worker threads while earlier ones are written */
+    const std::string root = outputRoot(mSpecs.fName());
+    auto format = [](unsigned, unsigned, const ComplexfArray& fid, std::vector<char>& text)
+    {
+        formatGnuplot(fid, text);
+    };
+    auto write = [&](unsigned level, unsigned replicate, const ComplexfArray& fid,
+                     const std::vector<char>& text)
+    {
+        // replicates are numbered only when there are several
+        char pLevel[32];
+        snprintf(pLevel, sizeof(pLevel), "-%3.2f", mNoiseTable[level].stdDev);
+        std::string base = "data/" + root + pLevel;
+        if (mNoiseTable[level].replicates > 1)
+            base += "-" + std::to_string(replicate);
 
         // write out as a gnuplot data set
-        sprintf(pOutFName, "data/%s-%3.2f.gp", pOutFNameRoot, pNoise[iSpec]);
-        std::ofstream os(pOutFName);
-        if (!os)
+        const std::string gpName = base + ".gp";
         {
-            printf("Could not open file: %s\n", pOutFName);
-            return false;
+            ScopedTimer timer(Instrument::WRITE);
+            std::ofstream os(gpName, std::ios::binary);
+            os.write(text.data(), text.size());
+            os.close();
+            if (!os)
+                throw std::runtime_error("Could not write file: " + gpName);
+            Instrument::count(Instrument::BYTES_WRITTEN, text.size());
+            Instrument::count(Instrument::SYSCALLS, 3);
         }
 
-        writeGnuplot(ComplexFid, os);
-        os.close();
+        // write out as a RANGER file so that it can be read later.
+        RangerWriter writer(base + ".rgr", rangerParams(uint64_t(fid.rows()), 1, fileInfo.sf,
+                                                        fileInfo.o1));
+        writer.write(reinterpret_cast<const float *>(fid.data()));
+        writer.close();
+
+        // now write out as a pronmr file, parameters and data together
+        const float *pData = reinterpret_cast<const float *>(fid.data());
+        fileInfo.writeFile(base + "p", pData, fid.rows() * 2, 1);
+    };
+    sweep(ComplexFid, format, write);
+}
 
-        // stream out so that it can be read later.
-        sprintf(pOutFName, "data/%s-%3.2f", pOutFNameRoot, pNoise[iSpec]);
-        os.open(pOutFName);
-        //ComplexFid.write(os);
-        os << ComplexFid;
-        os.close();
+void DataGenerator::generateRanger()
+{
+    ProNmr fileInfo;
 
-        // now write out as a pronmr file
-        strcat(pOutFName, "p");
-        if (Header.writeParams(pOutFName) != 0)
-        {
-            exit(1);
-        }
+    mSpecs.read();
 
-        float *pData = reinterpret_cast<float *>(ComplexFid.data());
-        int iNData = ComplexFid.rows() * 2;
-        if (Header.writeData(pData, pOutFName, iNData, Header.offsets[DAT], 1, 1)!= 0)
-        {
-            exit(1);
-        }
+    std::cout << "Read " << mSpecs.nLines() << " peaks." << std::endl;
+
+    RangerFile::Params params = rangerParams(uint64_t(mSpecs.fidSize()),
+                                             uint32_t(sweepSpectra().size()),
+                                             fileInfo.sf, fileInfo.o1);
+    const std::string name = "data/" + outputRoot(mSpecs.fName()) + ".rgr";
+
+    // FIDs too long for a ProNmr file are made a piece at a time in constant memory
+    if (mSpecs.fidSize() > MAXSIZE)
+    {
+        streamRanger(name, params, mSpecs.nLines(), mSpecs.dwell(), mSpecs.amplitude(),
+                     mSpecs.freq(), mSpecs.damp(), mSpecs.phase(), mSpecs.preDelay());
+        std::cout << "Synthesis: " << synthesisRate() << " samples*lines/s" << std::endl;
+        return;
     }
 
-    return 0;
+    ComplexfArray ComplexFid(mSpecs.fidSize());
+    makeSimFid(ComplexFid, mSpecs.nLines(), mSpecs.dwell(), mSpecs.amplitude(),
+               mSpecs.freq(), mSpecs.damp(), mSpecs.phase(), mSpecs.preDelay(), true);
+
+    std::cout << "Synthesis: " << synthesisRate() << " samples*lines/s" << std::endl;
 
+    // every spectrum of the noise sweep goes into the one file
+    RangerWriter writer(name, params);
+    sweep(ComplexFid, [&](unsigned, unsigned, const ComplexfArray& fid)
+    {
+        writer.write(reinterpret_cast<const float *>(fid.data()));
+    });
+    writer.close();
 }
 
-void DataGenerator::generateRanger()
+/* The kernel is set up once for all the lines and compiled for ACQUISITION
+   and the sample type, so nothing is decided per line or per sample. */
+template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+void DataGenerator::addLines(Sample *fid, long npts, unsigned nlines, float dwell,
+                             const float *amplitude, const float *freq, const float *damp,
+                             const float *phase, float de, bool zerofid)
+{
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    Instrument::count(Instrument::SAMPLES_GENERATED, npts);
+
+    if (zerofid)
+        std::fill(fid, fid + npts, Sample(0.0));
+
+    DecayKernel kernel(nlines, dwell, amplitude, freq, damp, phase, de, mSynthesisMode,
+                       mPrecision);
+    kernel.accumulate<ACQUISITION>(fid, 0, npts, mThreads);
+}
+
+/**********----------**********----------**********/
+void DataGenerator::addExpDecaySim(ComplexfArray &fid, float dwell, float amplitude,
+                       float freq, float damp, float phase, float de,
+                       bool zeroarray)
+{
+    addLines<SIMULTANEOUS>(fid.data(), fid.size(), 1, dwell, &amplitude, &freq, &damp, &phase,
+                           de, zeroarray);
+}
+
+
+/**********----------**********----------**********/
+void DataGenerator::addExpDecaySeq(FloatArray &fid, float dwell, float amplitude,
+         float freq, float damp, float phase, float de, bool zeroarray)
+{
+    addLines<SEQUENTIAL>(fid.data(), fid.size(), 1, dwell, &amplitude, &freq, &damp, &phase,
+                         de, zeroarray);
+}
+
+/**********----------**********----------**********/
+void DataGenerator::addExpDecaySin(FloatArray &fid, float dwell, float amplitude,
+         float freq, float damp, float phase, float de, bool zeroarray)
 {
+    addLines<SINGLE_CHANNEL>(fid.data(), fid.size(), 1, dwell, &amplitude, &freq, &damp,
+                             &phase, de, zeroarray);
+}
 
+/**********----------**********----------**********/
+void DataGenerator::makeSimFid(ComplexfArray &fid, unsigned nlines, float dwell,
+               const float *amplitude, const float *freq, const float *damp,
+               const float *phase, float de, bool zerofid)
+{
+    makeSimFid(fid.data(), fid.size(), nlines, dwell, amplitude, freq, damp, phase, de, zerofid);
 }
 
-void DataGenerator::addExpDecaySim(ComplexfArray& fid, float dwell, float amplitude, float freq,
-                                   float damp, float phase, float de, bool zeroarray)
+void DataGenerator::makeSimFid(Complexf *fid, long npts, unsigned nlines, float dwell,
+               const float *amplitude, const float *freq, const float *damp,
+               const float *phase, float de, bool zerofid)
 {
-    // convert input parameters to radians
-    phase *= M_PI / 180;
-    freq *= M_PI;
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    Instrument::count(Instrument::SAMPLES_GENERATED, npts);
+    auto start = std::chrono::steady_clock::now();
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * fFreq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = freq * de + phase;              /* starting angle */
+    if (zerofid)
+        std::fill(fid, fid + npts, Complexf(0.0, 0.0));
 
-    if (zeroarray)
-        fid.fill(0.0);
+    bool gridded = false;
+    if (mSynthesisEngine == NUFFT
+        || (mSynthesisEngine == AUTOMATIC
+            && double(nlines) * npts >= NufftSynth::CROSSOVER_WORK))
+    {
+        NufftSynth nufft(nlines, dwell, amplitude, freq, damp, phase, de, npts,
+                         mNufftTolerance);
+        if (mSynthesisEngine == NUFFT
+            || nufft.estimatedCost() < NufftSynth::directCost(nlines, npts))
+        {
+            nufft.accumulate(fid);
+            gridded = true;
+        }
+    }
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i++)
+    if (!gridded)
     {
-        fid(i) += amplitude * cos(angle) * decay;
-        fid(i) += amplitude * sin(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
+        DecayKernel kernel(nlines, dwell, amplitude, freq, damp, phase, de, mSynthesisMode,
+                           mPrecision);
+        kernel.accumulate(fid, 0, npts, mThreads);
     }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    mSynthesisRate = elapsed.count() > 0.0
+        ? double(npts) * nlines / elapsed.count() : 0.0;
 }
 
-void DataGenerator::addExpDecaySeq(FloatArray& fid, float dwell, float amplitude, float freq, float damp, float phase, float de, bool zeroarray)
+void DataGenerator::makeFid(Complexf *fid, long npts, const LineList& lines, float dwell,
+                            float de, float noiseLevel, uint32_t spectrum)
 {
-    // convert input parameters to radians
-    phase *= M_PI / 180;
-    freq *= 2.0 * M_PI;
+    if (npts < 0)
+        throw std::invalid_argument("Negative FID size: " + std::to_string(npts));
+    if (!(noiseLevel >= 0.0f))
+        throw std::invalid_argument("Invalid noise level: " + std::to_string(noiseLevel));
+    if (npts > 0 && fid == nullptr)
+        throw std::invalid_argument("No FID array.");
+    if (lines.nlines > 0 && (lines.amplitude == nullptr || lines.freq == nullptr
+                             || lines.damp == nullptr || lines.phase == nullptr))
+        throw std::invalid_argument("Incomplete line list.");
+
+    makeSimFid(fid, npts, lines.nlines, dwell, lines.amplitude, lines.freq, lines.damp,
+               lines.phase, de, true);
+    if (noiseLevel > 0.0f)
+        addNoise(reinterpret_cast<float *>(fid), 0, 2 * npts, noiseLevel, spectrum, mThreads);
+}
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * fFreq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = freq * de + phase;              /* starting angle */
+/**********----------**********----------**********/
+void DataGenerator::makeSeqFid(FloatArray &fid, unsigned nlines, float dwell,
+               const float *amplitude, const float *freq, const float *damp,
+               const float *phase, float de, bool zerofid)
+{
+    addLines<SEQUENTIAL>(fid.data(), fid.size(), nlines, dwell, amplitude, freq, damp, phase,
+                         de, zerofid);
+}
 
-    if (zeroarray)
-        fid.fill(0.0);
+/**********----------**********----------**********/
+void DataGenerator::makeSinFid(FloatArray &fid, unsigned nlines, float dwell,
+                 const float *amplitude, const float *freq, const float *damp,
+                 const float *phase, float de, bool zerofid)
+{
+    addLines<SINGLE_CHANNEL>(fid.data(), fid.size(), nlines, dwell, amplitude, freq, damp,
+                             phase, de, zerofid);
+}
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i += 2)
-    {
-        fid(i) += amplitude * cos(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
-        fid(i+1) -= amplitude * sin(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
-    }
+unsigned DataGenerator::twoDFids(TwoDMode mode, unsigned nincrements)
+{
+    return mode == TPPI ? nincrements : 2 * nincrements;
 }
 
-void DataGenerator::addExpDecaySin(FloatArray& fid, float dwell, float amplitude, float freq, float damp, float phase, float de, bool zeroarray)
+// bytes of consecutive FIDs made by one task of makeTwoDFid()
+static const long TWOD_TILE_BYTES = 1L << 20;
+
+void DataGenerator::makeTwoDFid(Complexf *fid, long npts, long stride, TwoDMode mode,
+                                unsigned nincrements, float dwell1, unsigned nlines,
+                                float dwell, const float *amplitude, const float *freq,
+                                const float *damp, const float *phase, const float *freq1,
+                                const float *damp1, float de)
 {
-    // convert input parameters to radians
-    phase *= M_PI / 180;
-    freq *= 2.0 * M_PI;
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    auto start = std::chrono::steady_clock::now();
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * fFreq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = freq * de + phase;              /* starting angle */
+    const unsigned nfids = twoDFids(mode, nincrements);
+    Instrument::count(Instrument::SAMPLES_GENERATED, uint64_t(npts) * nfids);
+    const unsigned perIncrement = nfids / std::max(nincrements, 1u);
 
-    if (zeroarray)
-        fid.fill(0.0);
+    // whole increments per tile so a hypercomplex pair is made together
+    const long fidBytes = std::max(long(npts * sizeof(Complexf)), 1L);
+    const unsigned tileFids = perIncrement
+        * unsigned(std::max(1L, TWOD_TILE_BYTES / (fidBytes * perIncrement)));
+    const unsigned ntiles = (nfids + tileFids - 1) / tileFids;
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i += 2)
+    parallelFor(mThreads, ntiles, [&](unsigned tile)
     {
-        fid(i) += amplitude * cos(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
-        fid(i+1) -= amplitude * sin(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
-    }
+        std::vector<float> lineAmplitude(nlines);
+        std::vector<float> linePhase(nlines);
+
+        const unsigned end = std::min(nfids, (tile + 1) * tileFids);
+        for (unsigned n = tile * tileFids; n < end; n++)
+        {
+            const unsigned increment = n / perIncrement;
+            const double t1 = double(increment) * dwell1;
+
+            // the t1 modulation of each line as a factor of its amplitude and a phase shift
+            for (unsigned i = 0; i < nlines; i++)
+            {
+                const double decay = amplitude[i] * std::exp(double(damp1[i]) * t1);
+                const double angle = 2.0 * M_PI * double(freq1[i]) * t1;
+                double shift = 0.0;
+
+                switch (mode)
+                {
+                case STATES:
+                    lineAmplitude[i] = float(decay * (n % 2 == 0 ? std::cos(angle)
+                                                                 : std::sin(angle)));
+                    break;
+                case TPPI:
+                    lineAmplitude[i] = float(decay * std::cos(angle + 0.5 * M_PI * increment));
+                    break;
+                case ECHO_ANTIECHO:
+                    lineAmplitude[i] = float(decay);
+                    shift = n % 2 == 0 ? -angle : angle;
+                    break;
+                }
+                linePhase[i] = float(std::remainder(phase[i] + shift * 180.0 / M_PI, 360.0));
+            }
+
+            Complexf *row = fid + long(n) * stride;
+            std::fill(row, row + npts, Complexf(0.0, 0.0));
+            DecayKernel kernel(nlines, dwell, lineAmplitude.data(), freq, damp,
+                               linePhase.data(), de, mSynthesisMode, mPrecision);
+            kernel.accumulate(row, 0, npts, 1);
+        }
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    mSynthesisRate = elapsed.count() > 0.0
+        ? double(npts) * nfids * nlines / elapsed.count() : 0.0;
 }
 
-void DataGenerator::makeSimFid(ComplexfArray& fid, unsigned nlines, float dwell, float* amplitude,
-                               float* freq, float* damp, float* phase, float phase_0, float de, bool zerofid)
+void DataGenerator::makeTwoDProNmr(const std::string& name, const ProNmr& params,
+                                   TwoDMode mode, unsigned nincrements, float dwell1,
+                                   unsigned nlines, float dwell, const float *amplitude,
+                                   const float *freq, const float *damp, const float *phase,
+                                   const float *freq1, const float *damp1, float de)
 {
-
+    const unsigned nfids = twoDFids(mode, nincrements);
+    if (nfids > std::numeric_limits<unsigned short>::max())
+        throw std::invalid_argument("Too many FIDs for a ProNmr file: " + std::to_string(nfids));
+
+    ProNmrMap map(name, params, int(nfids));
+    ProNmr& header = map.params();
+    header.nrecs = (unsigned short)nfids;
+    header.in2d = dwell1;
+    if (mode == TPPI)
+        header.dstatus &= ~HYPER_COMPLEX;
+    else
+        header.dstatus |= HYPER_COMPLEX;
+
+    // the blocks follow one another in the map, blockSize() floats apart
+    makeTwoDFid(map.complexData(1), params.si / 2, map.blockSize() / 2, mode, nincrements,
+                dwell1, nlines, dwell, amplitude, freq, damp, phase, freq1, damp1, de);
 }
 
-void DataGenerator::makeSeqFid(FloatArray& fid, unsigned nlines, float dwell, float* amplitude, float* freq, float* damp, float* phase, float phase_0, float de, bool zerofid)
+void DataGenerator::makeSeriesFid(Complexf *fid, long npts, long stride, SeriesLaw law,
+                                  unsigned nexp, const float *values, unsigned nlines,
+                                  float dwell, const float *amplitude, const float *freq,
+                                  const float *damp, const float *phase,
+                                  const float *constant, float de)
 {
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    Instrument::count(Instrument::SAMPLES_GENERATED, uint64_t(npts) * nexp);
+    auto start = std::chrono::steady_clock::now();
+
+    // the lines as they are before any law is applied
+    const DecayKernel base(nlines, dwell, amplitude, freq, damp, phase, de, mSynthesisMode,
+                           mPrecision);
 
+    parallelFor(mThreads, nexp, [&](unsigned n)
+    {
+        const double x = values[n];
+        Complexf *row = fid + long(n) * stride;
+        std::fill(row, row + npts, Complexf(0.0, 0.0));
+
+        if (law == TITRATION)
+        {
+            std::vector<float> shifted(nlines);
+            for (unsigned i = 0; i < nlines; i++)
+                shifted[i] = float(freq[i] + x * constant[i]);
+            DecayKernel kernel(nlines, dwell, amplitude, shifted.data(), damp, phase, de,
+                               mSynthesisMode, mPrecision);
+            kernel.accumulate(row, 0, npts, 1);
+            return;
+        }
+
+        std::vector<double> scale(nlines);
+        for (unsigned i = 0; i < nlines; i++)
+        {
+            const double c = constant[i];
+            switch (law)
+            {
+            case INVERSION_RECOVERY:
+                scale[i] = 1.0 - 2.0 * std::exp(-x / c);
+                break;
+            case TRANSVERSE_DECAY:
+                scale[i] = std::exp(-x / c);
+                break;
+            case DIFFUSION:
+                scale[i] = std::exp(-x * c);
+                break;
+            case TITRATION:
+                break;
+            }
+        }
+        base.scaled(scale.data()).accumulate(row, 0, npts, 1);
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    mSynthesisRate = elapsed.count() > 0.0
+        ? double(npts) * nexp * nlines / elapsed.count() : 0.0;
 }
 
-void DataGenerator::makeSinFid(FloatArray& fid, unsigned nlines, float dwell, float* amplitude, float* freq, float* damp, float* phase, float phase_0, float de, bool zerofid)
+void DataGenerator::makeSeriesProNmr(const std::string& name, const ProNmr& params,
+                                     SeriesLaw law, unsigned nexp, const float *values,
+                                     unsigned nlines, float dwell, const float *amplitude,
+                                     const float *freq, const float *damp,
+                                     const float *phase, const float *constant, float de)
 {
+    if (nexp > std::numeric_limits<unsigned short>::max())
+        throw std::invalid_argument("Too many experiments for a ProNmr file: "
+                                    + std::to_string(nexp));
 
+    // the vd list, each value as the shortest text that reads back the same
+    std::ofstream os(name + ".vd");
+    for (unsigned n = 0; n < nexp; n++)
+    {
+        char text[32];
+        char *end = std::to_chars(text, text + sizeof(text) - 1, values[n]).ptr;
+        *end++ = '\n';
+        os.write(text, end - text);
+    }
+    os.close();
+    if (!os)
+        throw std::runtime_error("Unable to write to file: " + name + ".vd");
+
+    ProNmrMap map(name, params, int(std::max(nexp, 1u)));
+    ProNmr& header = map.params();
+    header.nrecs = (unsigned short)nexp;
+    header.vd = nexp > 0 ? values[0] : 0.0;
+
+    makeSeriesFid(map.complexData(1), params.si / 2, map.blockSize() / 2, law, nexp, values,
+                  nlines, dwell, amplitude, freq, damp, phase, constant, de);
 }
 
+/* Counter blocks of the sequential uniform deviates.  Those of the per
+   sample deviates are numbered from 0 and those of GaussianNoise start at
+   2^31. */
+static const uint32_t SEQUENTIAL_BLOCK = 0x7fffffff;
+
+// GaussianNoise stream of the sequential gaussian deviates
+static const uint32_t SEQUENTIAL_STREAM = 0x7fffffff;
+
+// deviates per task in addNoise()
+static const long NOISE_BLOCK = 16384;
+
+// generate a uniform deviate in the range [0, 1)
 float DataGenerator::uniformDeviate()
 {
+    uint64_t position = mPosition++;
+    Philox::Block block = Philox(mSeed)(position / 4, mSpectrum, SEQUENTIAL_BLOCK);
+    return Philox::uniform(block.word[position % 4]);
+}
 
+float DataGenerator::uniformDeviate(uint64_t sample, uint32_t draw) const
+{
+    Philox::Block block = Philox(mSeed)(sample, mSpectrum, draw / 4);
+    return Philox::uniform(block.word[draw % 4]);
 }
 
 float DataGenerator::gaussianDeviate(float mean, float variance)
 {
+    GaussianNoise noise(mSeed, mSpectrum, SEQUENTIAL_STREAM);
+    return mean + sqrt(variance) * noise.deviate(mPosition++);
+}
+
+float DataGenerator::gaussianDeviate(float mean, float variance, uint64_t index,
+                                     uint32_t stream) const
+{
+    GaussianNoise noise(mSeed, mSpectrum, stream);
+    return mean + sqrt(variance) * noise.deviate(index);
+}
 
+void DataGenerator::addNoise(float *data, long count, float fStdDev)
+{
+    addNoise(data, 0, count, fStdDev, mSpectrum, mThreads);
 }
 
-void DataGenerator::addNoise(FloatArray& fid, float noiseLevel)
+/* adds stdDev * deviate(first + k) of stream 0 of spectrum to data[k],
+   k = 0 .. count - 1 */
+template <typename Real>
+void DataGenerator::addNoise(Real *data, uint64_t first, long count, float fStdDev,
+                             uint32_t spectrum, unsigned nthreads) const
 {
+    ScopedTimer timer(Instrument::NOISE);
+    Instrument::count(Instrument::NOISE_DEVIATES, count);
+
+    GaussianNoise noise(mSeed, spectrum, 0);
+    const unsigned nblocks = unsigned((count + NOISE_BLOCK - 1) / NOISE_BLOCK);
 
+    parallelFor(nthreads, nblocks, [&](unsigned block)
+    {
+        long start = block * NOISE_BLOCK;
+        noise.add(data + start, first + start, std::min(NOISE_BLOCK, count - start), fStdDev);
+    });
 }
 
-void DataGenerator::addNoise(ComplexfArray& Fid, float noiseLevel)
+void DataGenerator::addNoise(FloatArray &Fid, float fStdDev)
 {
+    addNoise(Fid.data(), Fid.rows(), fStdDev);
+}
 
+// point n gets deviates 2n (real) and 2n + 1 (imaginary)
+void DataGenerator::addNoise(ComplexfArray &Fid, float fStdDev)
+{
+    addNoise(reinterpret_cast<float *>(Fid.data()), 2 * Fid.rows(), fStdDev);
 }
 
-/**********----------**********----------**********/
-void DataGenerator::addExpDecaySim(ComplexfArray &fid, float dwell, float amplitude,
-                       float freq, float damp, float phase, float de,
-                       bool zeroarray)
+void DataGenerator::setNoiseTable(const std::vector<NoiseLevel>& table)
 {
-    // convert input parameters to radians
-    float fPhase = phase * 2.0 * M_PI / 360.0;
-    float fFreq = freq * 2.0 * M_PI;
+    mNoiseTable = table;
+}
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * fFreq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = fFreq * de + fPhase;              /* starting angle */
+const std::vector<DataGenerator::NoiseLevel>& DataGenerator::noiseTable() const
+{
+    return mNoiseTable;
+}
 
-    if (zeroarray)
-        fid.fill(0.0);
+std::vector<DataGenerator::NoiseLevel> DataGenerator::readNoiseTable(const std::string& fName)
+{
+    std::ifstream is(fName);
+    if (!is)
+        throw std::runtime_error("Unable to open file: " + fName);
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i++)
+    std::vector<NoiseLevel> table;
+    std::string line;
+    while (std::getline(is, line))
     {
-        fid(i) += amplitude * cos(angle) * decay;
-        fid(i) += amplitude * sin(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
+        std::istringstream fields(line);
+        NoiseLevel level = {0.0, 1};
+        if (!(fields >> level.stdDev))
+            continue;   // blank line
+        fields >> level.replicates;
+        table.push_back(level);
     }
+
+    if (is.bad())
+        throw std::runtime_error("Failure reading file: " + fName);
+
+    return table;
 }
 
+// bytes of FIDs sweep() keeps at once
+static const long SWEEP_BYTES = 64L << 20;
 
-/**********----------**********----------**********/
-void DataGenerator::addExpDecaySeq(FloatArray &fid, float dwell, float amplitude,
-         float freq, float damp, float phase, float de, bool zeroarray)
+// (level, replicate) of every spectrum of a sweep, in order
+std::vector<std::pair<unsigned, unsigned>> DataGenerator::sweepSpectra() const
+{
+    std::vector<std::pair<unsigned, unsigned>> spectra;
+    for (unsigned level = 0; level < mNoiseTable.size(); level++)
+        for (unsigned replicate = 0; replicate < mNoiseTable[level].replicates; replicate++)
+            spectra.emplace_back(level, replicate);
+    return spectra;
+}
+
+/* adds the noise of points first .. first + npts - 1 of spectrum n of a
+   sweep to the npts points of fid */
+template <typename Real>
+void DataGenerator::addSweepNoise(std::complex<Real> *fid, uint64_t first, long npts, size_t n,
+                                  unsigned level, unsigned nthreads) const
 {
-    // convert input parameters to radians
-    phase *= 2.0 * M_PI;
-    freq *= 2.0 * M_PI;
+    const float stdDev = mNoiseTable[level].stdDev;
+    if (stdDev != 0.0)
+        addNoise(reinterpret_cast<Real *>(fid), 2 * first, 2 * npts, stdDev,
+                 mSpectrum + uint32_t(n), nthreads);
+}
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * freq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = freq * de + phase;              /* starting angle */
+void DataGenerator::sweep(const ComplexfArray& clean, const SweepSink& sink)
+{
+    const std::vector<std::pair<unsigned, unsigned>> spectra = sweepSpectra();
 
-    if (zeroarray)
-        fid.fill(0.0);
+    const long fidBytes = std::max(long(clean.rows() * sizeof(Complexf)), 1L);
+    const unsigned batchSize = unsigned(std::max(1L, std::min(4L * mThreads,
+                                                              SWEEP_BYTES / fidBytes)));
+    std::vector<ComplexfArray> batch(batchSize);
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i += 2)
+    for (size_t first = 0; first < spectra.size(); first += batchSize)
     {
-        fid(i) += amplitude * cos(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
-        fid(i+1) -= amplitude * sin(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
+        const unsigned count = unsigned(std::min(size_t(batchSize), spectra.size() - first));
+
+        // threads go to separate spectra if there are several, otherwise to the one
+        const unsigned nthreads = count > 1 ? 1 : mThreads;
+        parallelFor(mThreads, count, [&](unsigned i)
+        {
+            ComplexfArray& fid = batch[i];
+            fid = clean;
+            addSweepNoise(fid.data(), 0, fid.rows(), first + i, spectra[first + i].first, nthreads);
+        });
+
+        for (unsigned i = 0; i < count; i++)
+            sink(spectra[first + i].first, spectra[first + i].second, batch[i]);
     }
 }
 
-/**********----------**********----------**********/
-void DataGenerator::addExpDecaySin(FloatArray &fid, float dwell, float amplitude,
-         float freq, float damp, float phase, float de, bool zeroarray)
-{
-    // convert input parameters to radians
-    phase *= 2.0 * M_PI;
-    freq *= 2.0 * M_PI;
+// spectra in flight per worker of the pipelined sweep()
+static const unsigned PIPELINE_BUFFERS = 2;
 
-    float dw_decay = exp(damp * dwell);           /* decay per dwell */
-    float dw_angle = dwell * freq;                /* evolution per dwell */
-    float decay = exp(damp * de);                 /* starting decay */
-    float angle = freq * de + phase;              /* starting angle */
+void DataGenerator::sweep(const ComplexfArray& clean, const SweepFormatter& format,
+                          const SweepWriter& write)
+{
+    const std::vector<std::pair<unsigned, unsigned>> spectra = sweepSpectra();
+    if (spectra.empty())
+        return;
 
-    if (zeroarray)
-        fid.fill(0.0);
+    struct Slot
+    {
+        size_t n;       // of the spectrum in the sweep
+        ComplexfArray fid;
+        std::vector<char> output;
+    };
+
+    // as many spectra in flight as the workers can use and SWEEP_BYTES allows
+    const unsigned nworkers = unsigned(std::min(size_t(std::max(mThreads, 1u)), spectra.size()));
+    const long fidBytes = std::max(long(clean.rows() * sizeof(Complexf)), 1L);
+    const size_t nslots = size_t(std::max(2L, std::min(long(PIPELINE_BUFFERS * nworkers),
+                                                       SWEEP_BYTES / fidBytes)));
+
+    std::vector<Slot> slots(nslots);
+    BoundedQueue<Slot *> freeSlots(nslots);
+    BoundedQueue<Slot *> readySlots(nslots);
+    for (Slot& slot : slots)
+        freeSlots.push(&slot);
+
+    /* A worker takes a free buffer before it takes a spectrum, so the
+       lowest spectrum not yet written always has a buffer and the writer
+       cannot wait on a worker that is waiting on the writer. */
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::thread workers([&]()
+    {
+        try
+        {
+            parallelFor(nworkers, nworkers, [&](unsigned)
+            {
+                try
+                {
+                    Slot *slot;
+                    while (freeSlots.pop(slot))
+                    {
+                        const size_t n = next++;
+                        if (n >= spectra.size())
+                            break;
+
+                        slot->n = n;
+                        slot->fid = clean;
+                        addSweepNoise(slot->fid.data(), 0, slot->fid.rows(), n,
+                                      spectra[n].first, 1);
+                        slot->output.clear();
+                        format(spectra[n].first, spectra[n].second, slot->fid, slot->output);
+                        if (!readySlots.push(slot))
+                            break;
+                    }
+                }
+                catch (...)
+                {
+                    // stop the other workers and the writer
+                    freeSlots.close();
+                    readySlots.close();
+                    throw;
+                }
+            });
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        readySlots.close();
+    });
 
-    /* off we go */
-    for (unsigned i = 0; i < fid.size(); i++)
+    // spectra arrive in any order and are written in order
+    std::vector<Slot *> pending(spectra.size(), nullptr);
+    size_t written = 0;
+    try
     {
-        fid(i) += amplitude * cos(angle) * decay;
-        decay *= dw_decay;
-        angle += dw_angle;
+        Slot *slot;
+        while (written < spectra.size() && readySlots.pop(slot))
+        {
+            pending[slot->n] = slot;
+            while (written < spectra.size() && pending[written] != nullptr)
+            {
+                Slot *done = pending[written];
+                write(spectra[written].first, spectra[written].second, done->fid, done->output);
+                pending[written++] = nullptr;
+                freeSlots.push(done);
+            }
+        }
+    }
+    catch (...)
+    {
+        freeSlots.close();
+        readySlots.close();
+        workers.join();
+        throw;
     }
+
+    freeSlots.close();
+    workers.join();
+    if (error)
+        std::rethrow_exception(error);
 }
 
-/**********----------**********----------**********/
-void DataGenerator::makeSimFid(ComplexfArray &fid, unsigned nlines, float dwell,
-               float *amplitude, float *freq, float *damp,
-               float *phase, float phase_0, float de, bool zerofid)
+void DataGenerator::sweepProNmr(const std::string& name, const ProNmr& params, unsigned nlines,
+                                float dwell, const float *amplitude, const float *freq,
+                                const float *damp, const float *phase, float de)
+{
+    const std::vector<std::pair<unsigned, unsigned>> spectra = sweepSpectra();
+    if (spectra.empty())
+        return;
+
+    ProNmrMap map(name, params, int(spectra.size()));
+    map.params().nrecs = (unsigned short)spectra.size();
 
-/* Use the above adddecay() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is not FALSE then
-   the array will be cleared before proceeding */
+    const long npts = params.si / 2;
+    Complexf *first = map.complexData(1);
+    makeSimFid(first, npts, nlines, dwell, amplitude, freq, damp, phase, de, true);
 
+    // the first block is the source of the copies so it gets its noise last
+    const unsigned nthreads = spectra.size() > 2 ? 1 : mThreads;
+    parallelFor(mThreads, unsigned(spectra.size() - 1), [&](unsigned i)
+    {
+        Complexf *fid = map.complexData(int(i) + 2);
+        std::copy(first, first + npts, fid);
+        addSweepNoise(fid, 0, npts, i + 1, spectra[i + 1].first, nthreads);
+    });
+    addSweepNoise(first, 0, npts, 0, spectra[0].first, mThreads);
+}
+
+// points of each piece made by streamRanger()
+static const long STREAM_POINTS = 65536;
+
+void DataGenerator::streamRanger(const std::string& name, const RangerFile::Params& params,
+                                 unsigned nlines, float dwell, const float *amplitude,
+                                 const float *freq, const float *damp, const float *phase,
+                                 float de)
 {
-    if (zerofid)
-        fid.fill(Complexf(0.0, 0.0));
+    if (!RangerFile::validType(params.sampleType))
+        throw std::invalid_argument("Unknown RANGER sample type: "
+                                    + std::to_string(params.sampleType));
+
+    const std::vector<std::pair<unsigned, unsigned>> spectra = sweepSpectra();
+
+    RangerFile::Params fileParams = params;
+    fileParams.sampleType = RangerFile::sampleType(RangerFile::storage(params.sampleType), true);
+    fileParams.nspectra = uint32_t(spectra.size());
+    RangerWriter writer(name, fileParams);
+
+    // the pieces are kept in the precision of the sums until they are written
+    DecayKernel kernel(nlines, dwell, amplitude, freq, damp, phase, de, mSynthesisMode,
+                       mPrecision);
+    if (mPrecision == DOUBLE_PRECISION)
+        streamSpectra<double>(writer, spectra, kernel, nlines);
+    else
+        streamSpectra<float>(writer, spectra, kernel, nlines);
+    writer.close();
+}
+
+// the loop of streamRanger(), with the pieces held as std::complex<Real>
+template <typename Real>
+void DataGenerator::streamSpectra(RangerWriter& writer,
+                                  const std::vector<std::pair<unsigned, unsigned>>& spectra,
+                                  const DecayKernel& kernel, unsigned nlines)
+{
+    typedef std::complex<Real> Sample;
+
+    const uint64_t npoints = writer.params().npoints;
+    const unsigned batchSize = unsigned(std::max<size_t>(1, std::min<size_t>(mThreads,
+                                                                            spectra.size())));
+    std::vector<Sample> clean(STREAM_POINTS);
+    std::vector<Sample> batch(size_t(batchSize) * STREAM_POINTS);
+    double synthesisTime = 0.0;
+
+    for (uint64_t first = 0; first < npoints; first += STREAM_POINTS)
+    {
+        const long npts = long(std::min(uint64_t(STREAM_POINTS), npoints - first));
+
+        {
+            ScopedTimer timer(Instrument::SYNTHESIS);
+            Instrument::count(Instrument::SAMPLES_GENERATED, npts);
+            auto synthesisStart = std::chrono::steady_clock::now();
+            std::fill(clean.begin(), clean.begin() + npts, Sample(0.0, 0.0));
+            kernel.accumulateSamples<SIMULTANEOUS>(clean.data(), long(first), npts, mThreads);
+            std::chrono::duration<double> elapsed
+                = std::chrono::steady_clock::now() - synthesisStart;
+            synthesisTime += elapsed.count();
+        }
+
+        // every spectrum gets its own noise on this piece of the one noiseless FID
+        for (size_t n0 = 0; n0 < spectra.size(); n0 += batchSize)
+        {
+            const unsigned count = unsigned(std::min(size_t(batchSize), spectra.size() - n0));
+            const unsigned nthreads = count > 1 ? 1 : mThreads;
+            parallelFor(mThreads, count, [&](unsigned i)
+            {
+                Sample *fid = &batch[size_t(i) * STREAM_POINTS];
+                std::copy(clean.begin(), clean.begin() + npts, fid);
+                addSweepNoise(fid, first, npts, n0 + i, spectra[n0 + i].first, nthreads);
+            });
+
+            for (unsigned i = 0; i < count; i++)
+                writer.write(uint32_t(n0 + i), first, uint64_t(npts),
+                             reinterpret_cast<const Real *>(&batch[size_t(i) * STREAM_POINTS]));
+        }
+    }
+
+    mSynthesisRate = synthesisTime > 0.0 ? double(npoints) * nlines / synthesisTime : 0.0;
+}
+
+/* The parameters of the RANGER files of generate(): npoints points of the
+   spec file's lines stored as storage(). */
+RangerFile::Params DataGenerator::rangerParams(uint64_t npoints, uint32_t nspectra, double sf,
+                                               double o1) const
+{
+    RangerFile::Params params = {
+        RangerFile::sampleType(mStorage, true), npoints, nspectra, 0,
+        mSpecs.dwell(), mSpecs.preDelay(), sf, o1, mSeed,
+        storageScale(long(npoints), unsigned(mSpecs.nLines()), mSpecs.dwell(),
+                     mSpecs.amplitude(), mSpecs.damp(), mSpecs.preDelay())
+    };
+    return params;
+}
 
+double DataGenerator::storageScale(long npts, unsigned nlines, float dwell,
+                                   const float *amplitude, const float *damp, float de) const
+{
+    // a line is largest at the start if it decays and at the end if it grows
+    const double end = de + double(std::max(npts - 1, 0L)) * dwell;
+    double peak = 0.0;
     for (unsigned i = 0; i < nlines; i++)
-        addExpDecaySim(fid, dwell, amplitude[i], freq[i],
-                       damp[i], phase[i] + phase_0, de, false);
+        peak += std::abs(double(amplitude[i])) * std::exp(double(damp[i])
+                                                          * (damp[i] > 0.0f ? end : de));
+
+    float noise = 0.0;
+    for (const NoiseLevel& level : mNoiseTable)
+        noise = std::max(noise, level.stdDev);
+    peak += 7.5 * noise;
+
+    return peak > 0.0 && std::isfinite(peak) ? 2147483647.0 / peak : 1.0;
 }
 
-/**********----------**********----------**********/
-void DataGenerator::makeSeqFid(FloatArray &fid, unsigned nlines, float dwell,
-               float *amplitude, float *freq, float *damp,
-               float *phase, float phase_0, float de, bool zerofid)
+void DataGenerator::setSeed(uint64_t seed)
+{
+    mSeed = seed;
+}
 
-/* Use the above adddecay() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is not false then
-   the array will be cleared before proceeding */
+uint64_t DataGenerator::seed() const
+{
+    return mSeed;
+}
 
+void DataGenerator::setSpectrum(uint32_t spectrum)
 {
-    unsigned i;
+    mSpectrum = spectrum;
+    mPosition = 0;
+}
 
-    if (zerofid)
-        fid.fill(0.0);
+uint32_t DataGenerator::spectrum() const
+{
+    return mSpectrum;
+}
 
-    for (unsigned i = 0; i < nlines; i++)
-        AddExpDecaySeq(fid, dwell, amplitude[i], freq[i],
-                          damp[i], phase[i] + phase_0, de, false);
+double DataGenerator::synthesisRate() const
+{
+    return mSynthesisRate;
 }
 
-/**********----------**********----------**********/
-void DataGenerator::makeSinFid(FloatArray &fid, unsigned nlines, float dwell,
-                 float *amplitude, float *freq, float *damp,
-                 float *phase, float de, bool zerofid)
+void DataGenerator::setSynthesisMode(SynthesisMode mode)
+{
+    mSynthesisMode = mode;
+}
 
-/* Use the above adddecay() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is not false then
-   the array will be cleared before proceeding */
+DataGenerator::SynthesisMode DataGenerator::synthesisMode() const
+{
+    return mSynthesisMode;
+}
 
+void DataGenerator::setPrecision(Precision precision)
 {
-    if (zerofid)
-        fid.fill(0.0);
+    mPrecision = precision;
+}
 
-    for (unsigned i = 0; i < nlines; i++)
-        AddExpDecaySin(fid, dwell, amplitude[i], freq[i],
-                          damp[i], phase[i] + phase_0, de, false);
+DataGenerator::Precision DataGenerator::precision() const
+{
+    return mPrecision;
 }
 
-// generate a uniform deviate in the range [0, 1]
-float DataGenerator::uniformDeviate()
+void DataGenerator::setStorage(RangerFile::Storage storage)
 {
-    // random(1) generates a long in the range [0, 2**31-1] so we have to scale
-    // it back a bit
-    const float MAX_RAND = 0xffffffff / 2;
-    return float(random()) / MAX_RAND;
+    mStorage = storage;
 }
 
-// generate a unit gaussian using the central limit theorem
-float DataGenerator::gaussianDeviate(float mean, float variance)
+RangerFile::Storage DataGenerator::storage() const
 {
-    // the more the better
-    const unsigned NLOOPS = 20;
+    return mStorage;
+}
 
-    float fNum = 0.0;
-    for (unsigned iIdx = 0; iIdx < NLOOPS; iIdx++)
-    {
-        fNum += float(uniformDeviate());
-    }
-    //for uniform randoms in [0,1], mu = 0.5 and var = 1/12
-    // adjust X so mu = 0 and var = 1
-    fNum -= NLOOPS / 2;          // set mean to 0.0
-    fNum *= sqrt(12.0 / NLOOPS); // adjust variance to 1.0
+void DataGenerator::setThreads(unsigned nthreads)
+{
+    mThreads = nthreads > 0 ? nthreads : hardwareThreads();
+}
 
-    // set mean and variance to requested values
-    return (mean + sqrt(variance) * fNum);
+unsigned DataGenerator::threads() const
+{
+    return mThreads;
 }
 
-void DataGenerator::addNoise(FloatArray &Fid, float fStdDev)
+void DataGenerator::setSynthesisEngine(SynthesisEngine engine)
 {
-    for (unsigned iIdx = 0; iIdx < Fid.rows(); iIdx++)
-    {
-        Float fNum = gaussianDeviate(0.0, fStdDev * fStdDev);
-        Fid(iIdx) += fNum;
-    }
+    mSynthesisEngine = engine;
 }
 
-void DataGenerator::addNoise(ComplexfArray &Fid, float fStdDev)
+DataGenerator::SynthesisEngine DataGenerator::synthesisEngine() const
 {
-    for (unsigned iIdx = 0; iIdx < Fid.rows(); iIdx++)
-    {
-        Float fNum1 = gaussianDeviate(0.0, fStdDev * fStdDev);
-        Float fNum2 = gaussianDeviate(0.0, fStdDev * fStdDev);
-        Fid(iIdx) += Complexf(fNum1, fNum2);
-    }
+    return mSynthesisEngine;
+}
+
+void DataGenerator::setNufftTolerance(double tolerance)
+{
+    if (!(tolerance > 0.0 && tolerance < 1.0))
+        throw std::invalid_argument("NUFFT tolerance must be between 0 and 1.");
+    mNufftTolerance = tolerance;
+}
+
+double DataGenerator::nufftTolerance() const
+{
+    return mNufftTolerance;
 }
@@ -21,10 +21,15 @@
 #ifndef DATAGENERATOR_H
 #define DATAGENERATOR_H
 
+#include "RangerFile.h"
+
 #include <Eigen/Dense>
 
 #include <string>
 #include <complex>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 
 using Float = float;
@@ -33,6 +38,12 @@ using FloatArray = Eigen::Matrix<Float, Eigen::Dynamic, 1>;
 using Complexf = std::complex<Float>;
 using ComplexfArray = Eigen::Matrix<Complexf, Eigen::Dynamic, 1>;
 
+using Complexd = std::complex<double>;
+
+class BinarySpec;
+class DecayKernel;
+class ProNmr;
+
 class DataGenerator
 {
 public:
@@ -46,11 +57,109 @@ public:
         SUCCESS, FAILURE
     };
 
+    /* How the decay kernels evaluate exp((damp + i*freq) * t).
+       TRIGONOMETRIC calls sin() and cos() for every sample.  PHASOR steps a
+       complex phasor by one multiplication per sample and resets it to the
+       exact value every DecayKernel::SEGMENT_POINTS samples (see
+       DecayKernel for the error bound). */
+    enum SynthesisMode
+    {
+        TRIGONOMETRIC, PHASOR
+    };
+
+    /* The precision the decay kernels sum in, chosen separately from the
+       storage of the samples.  SINGLE_PRECISION sums in float.
+       DOUBLE_PRECISION steps the phasors and sums the lines in double, so
+       that the error of a sample no longer grows with the steps since the
+       last restart or with the number of lines, at about twice the cost
+       in PHASOR mode and four to five times in TRIGONOMETRIC.  Either way
+       the sums are rounded once, to the sample type of the FID or of the
+       file they are written to. */
+    enum Precision
+    {
+        SINGLE_PRECISION, DOUBLE_PRECISION
+    };
+
+    /* How the receiver records the signal.  Sample n is taken at time
+       de + n * dwell and z is the sum of the lines at that time.
+       SIMULTANEOUS records complex samples z.  SEQUENTIAL (Bruker) records
+       real samples, Re(z) for even n and -Im(z) for odd n.  SINGLE_CHANNEL
+       records real samples Re(z).  DecayKernel is compiled separately for
+       each, so the choice is made once per FID. */
+    enum Acquisition
+    {
+        SIMULTANEOUS, SEQUENTIAL, SINGLE_CHANNEL
+    };
+
+    /* Which algorithm makeSimFid() uses.  DIRECT sums every line at every
+       sample with DecayKernel, NUFFT grids the lines with NufftSynth and
+       AUTOMATIC picks NUFFT when lines * points is past
+       NufftSynth::CROSSOVER_WORK and its estimated cost is lower. */
+    enum SynthesisEngine
+    {
+        AUTOMATIC, DIRECT, NUFFT
+    };
+
+    /* How the t1 evolution of a 2D data set is recorded (see makeTwoDFid()).
+       STATES records a cosine and a sine modulated FID for each t1
+       increment (hypercomplex data).  TPPI records one FID per increment
+       with the phase of the t1 modulation advanced 90 degrees each time,
+       so it needs half the STATES t1 dwell for the same F1 width.
+       ECHO_ANTIECHO records the echo (N-type, exp(-i*omega1*t1)) and the
+       antiecho (P-type, exp(+i*omega1*t1)) FIDs of each increment. */
+    enum TwoDMode
+    {
+        STATES, TPPI, ECHO_ANTIECHO
+    };
+
+    /* Laws of the arrayed (pseudo-2D) experiments of makeSeriesFid().  The
+       array value x of each experiment and a constant c of each line give
+         INVERSION_RECOVERY  amplitude * (1 - 2 * exp(-x / c)),
+                             x the recovery delay (s) and c T1 (s)
+         TRANSVERSE_DECAY    amplitude * exp(-x / c),
+                             x the echo time (s) and c T2 (s)
+         DIFFUSION           amplitude * exp(-x * c), the Stejskal-Tanner
+                             law with x = (gamma * G * delta)^2
+                             * (Delta - delta / 3) (s / m^2) and c the
+                             diffusion coefficient (m^2 / s)
+         TITRATION           freq + x * c,
+                             x the titrant ratio and c the shift per unit x (Hz) */
+    enum SeriesLaw
+    {
+        INVERSION_RECOVERY, TRANSVERSE_DECAY, DIFFUSION, TITRATION
+    };
+
+    /* One entry of the noise table: the standard deviation of the noise
+       and the number of spectra with independent noise made at that level. */
+    struct NoiseLevel
+    {
+        float stdDev;
+        unsigned replicates;
+    };
+
+    // receives each spectrum made by sweep()
+    typedef std::function<void(unsigned level, unsigned replicate, const ComplexfArray& fid)>
+        SweepSink;
+
+    // formats a spectrum of the pipelined sweep() into output, on a worker thread
+    typedef std::function<void(unsigned level, unsigned replicate, const ComplexfArray& fid,
+                               std::vector<char>& output)> SweepFormatter;
+
+    // writes a spectrum of the pipelined sweep() and its formatted output
+    typedef std::function<void(unsigned level, unsigned replicate, const ComplexfArray& fid,
+                               const std::vector<char>& output)> SweepWriter;
+
     class InputSpecs
     {
     public:
         InputSpecs(OutputFormat format, const std::string& fName);
         InputSpecs(const InputSpecs& specs);
+
+        /* Reads the FID size, dwell and pre-acquisition delay and then the
+           line list from the file, which may be text (see SpecFile) or
+           binary (see BinarySpec).  Binary files stay mapped and their
+           columns are used in place.  Throws std::runtime_error, giving
+           the line and column of any error in a text file. */
         void read();
         void init();
         OutputFormat format() const;
@@ -59,10 +168,12 @@ public:
         int nLines() const;
         float dwell() const;
         float preDelay() const;
-        float amplitude() const;
-        float freq() const;
-        float damp() const;
-        float phase() const;
+
+        // the line list, nLines() entries each
+        const float *amplitude() const;
+        const float *freq() const;
+        const float *damp() const;
+        const float *phase() const;
 
     private:
         OutputFormat mFormat;
@@ -75,95 +186,363 @@ public:
         std::vector<float> mFreq;
         std::vector<float> mDamp;
         std::vector<float> mPhase;
+        std::shared_ptr<const BinarySpec> mBinary;     // the line list, if binary
+    };
+
+    /* The line list of makeFid(), nlines entries in each array with the
+       units of makeSimFid().  The arrays belong to the caller. */
+    struct LineList
+    {
+        unsigned nlines;
+        const float *amplitude;
+        const float *freq;
+        const float *damp;
+        const float *phase;
     };
 
     DataGenerator(const InputSpecs& specs);
 
+/* A generator with no spec file, for callers that link the library
+   (nmrsimlib.pro) and make FIDs in their own memory with makeFid() and the
+   other make*Fid() functions.  generate() throws std::invalid_argument. */
+    DataGenerator();
+
     void generate();
     void generateProNmrFid();
     void generateRanger();
 
 
 /**
-        Adds a decay to the data in fid.  The array is zeroed first if zeroarray != 0.
+        Adds a decay to the data in fid, recorded SIMULTANEOUS.  The array
+        is zeroed first if zeroarray != 0.
 
         fid          -- complex array of at least npts in length
-        npts         -- number of time points to compute for FID
         dwell        -- dwell period (s)
         amplitude    -- amplitude (peak areas) of line (== value at time == 0)
-        frequency    -- frequency (rotating frame) for each component (rad)
+        frequency    -- frequency (rotating frame) of the line (Hz)
         damp         -- damping factor (1 / s)
-        phase        -- phase of line at time == 0 (radians)
-        de           -- pre-acq delay
+        phase        -- phase of line at time == 0 (degrees)
+        de           -- pre-acq delay (s)
 
 */
     void addExpDecaySim(ComplexfArray& fid, float dwell, float amplitude, float freq,
                         float damp, float phase, float de, bool zeroarray);
 
-/**      Adds a sequential decay to the data in fid.  The array is zeroed
-        first if zeroarray != 0.  We negate the "imaginary" channel
-        to keep this consistent with Bruker conventions.
-
-        fid          -- real array of at least npts in length
-        dwell        -- dwell period (s)
-        amplitude    -- amplitude (peak areas) of line (== value at time == 0)
-        frequency    -- frequency (rotating frame) for each component (rad)
-        damp         -- damping factor (1 / s)
-        phase        -- phase of line at time == 0 (radians)
-        de           -- pre-acq delay
+/**      Adds a sequential decay to the data in fid, recorded SEQUENTIAL.
+        The array is zeroed first if zeroarray != 0.  We negate the
+        "imaginary" channel to keep this consistent with Bruker conventions.
+        The parameters are those of addExpDecaySim().
 */
 
     void addExpDecaySeq(FloatArray& fid, float dwell, float amplitude, float freq,
                         float damp, float phase, float de, bool zeroarray);
-/**      Adds a real decay to the data in fid.  The array is zeroed first if
-        zeroarray != 0.
-
-        fid          -- real array of at least fid.size() in length
-        dwell        -- dwell period (s)
-        amplitude    -- amplitude (peak areas) of line (== value at time == 0)
-        frequency    -- frequency (rotating frame) for each component (rad)
-        damp         -- damping factor (1 / s)
-        phase        -- phase of line at time == 0 (radians)
-        de           -- pre-acq delay
+/**      Adds a real decay to the data in fid, recorded SINGLE_CHANNEL.  The
+        array is zeroed first if zeroarray != 0.  The parameters are those
+        of addExpDecaySim().
 */
     void addExpDecaySin(FloatArray& fid, float dwell, float amplitude, float freq,
                         float damp, float phase, float de, bool zeroarray);
 
-/** Use the above addExpDecaySim() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is "true" then
-   the array will be cleared before proceeding */
-    void makeSimFid(ComplexfArray& fid, unsigned nlines, float dwell, float *amplitude,
-                    float *freq, float *damp, float *phase, float de, bool zerofid);
+/** Generate a complete fid from the lines in the arrays, which must have
+   been initialised with at least nlines entries.  The sum is the same as
+   calling addExpDecaySim() for each line but is done by DecayKernel, which
+   evaluates blocks of lines together in vector registers, or for large
+   line lists by NufftSynth (see setSynthesisEngine()).  If zerofid is
+   "true" then the array will be cleared before proceeding */
+    void makeSimFid(ComplexfArray& fid, unsigned nlines, float dwell, const float *amplitude,
+                    const float *freq, const float *damp, const float *phase, float de,
+                    bool zerofid);
 
-/* Use the above AddExpDecaySeq() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is "true" then
-   the array will be cleared before proceeding */
-    void makeSeqFid(FloatArray& fid, unsigned nlines, float dwell, float *amplitude, float *freq,
-                    float *damp, float *phase, float de, bool zerofid);
+// the same for the npts points of fid, which may be mapped from a file (see ProNmrMap)
+    void makeSimFid(Complexf *fid, long npts, unsigned nlines, float dwell,
+                    const float *amplitude, const float *freq, const float *damp,
+                    const float *phase, float de, bool zerofid);
 
-/* Use the above AddExpDecaySin() to generate a complete fid.  The
-   parameters are in the arrays which must have been initialised
-   with at least nlines entries.  If zeroarray is "true" then
+/**
+        Make the FID of lines in npts points of fid, which belongs to the
+        caller, with no file I/O and nothing printed: the clean FID of
+        makeSimFid() plus, if noiseLevel > 0, noise of standard deviation
+        noiseLevel, point n getting the deviates 2n and 2n + 1 of spectrum
+        index spectrum as in addNoise().  The noise is a function of seed()
+        and spectrum alone, not of the calls before, so the same arguments
+        always give the same FID.
+
+        fid          -- complex array of at least npts in length
+        lines        -- the line list
+        dwell        -- dwell period (s)
+        de           -- pre-acq delay (s)
+        noiseLevel   -- standard deviation of the noise, 0 for none
+        spectrum     -- noise spectrum index
+
+        The generator is not changed other than synthesisRate(), so one
+        per thread is enough for several threads to make FIDs at once; use
+        setThreads(1) for each when they make many small FIDs, as the
+        threads of every call would otherwise be started anew.  Throws
+        std::invalid_argument for a negative npts or noiseLevel or a null
+        array.
+*/
+    void makeFid(Complexf *fid, long npts, const LineList& lines, float dwell, float de,
+                 float noiseLevel = 0.0f, uint32_t spectrum = 0);
+
+/* Generate a complete sequentially acquired fid from the lines in the
+   arrays, with the same conventions as addExpDecaySeq().  The arrays must
+   have been initialised with at least nlines entries.  If zerofid is
+   "true" then the array will be cleared before proceeding */
+    void makeSeqFid(FloatArray& fid, unsigned nlines, float dwell, const float *amplitude,
+                    const float *freq, const float *damp, const float *phase, float de,
+                    bool zerofid);
+
+/* Generate a complete single channel fid from the lines in the arrays, with
+   the same conventions as addExpDecaySin().  The arrays must have been
+   initialised with at least nlines entries.  If zerofid is "true" then
    the array will be cleared before proceeding */
-    void makeSinFid(FloatArray& fid, unsigned nlines, float dwell, float *amplitude, float *freq,
-                    float *damp, float *phase, float de, bool zerofid);
+    void makeSinFid(FloatArray& fid, unsigned nlines, float dwell, const float *amplitude,
+                    const float *freq, const float *damp, const float *phase, float de,
+                    bool zerofid);
+
+// FIDs in a 2D data set of nincrements t1 increments recorded in mode
+    static unsigned twoDFids(TwoDMode mode, unsigned nincrements);
+
+/**
+        Generate a 2D data set: the twoDFids(mode, nincrements) FIDs of npts
+        points recorded at t1 = 0, dwell1, 2 * dwell1 ... in order, FID n
+        starting at fid[n * stride].  The arrays must have been initialised
+        with at least nlines entries.
+
+        mode         -- how t1 is recorded
+        nincrements  -- number of t1 increments
+        dwell1       -- t1 increment (s)
+        dwell, amplitude, freq, damp, phase, de
+                     -- as for makeSimFid(), describing t2
+        freq1        -- F1 frequency of each line (Hz)
+        damp1        -- F1 damping factor of each line (1 / s)
+
+        Each FID is a sum of lines with the t1 modulation folded into their
+        amplitudes and phases and is made by DecayKernel on one thread, so
+        the increments are made in parallel, tiles of consecutive FIDs at
+        a time, and the result does not depend on the thread count.
+*/
+    void makeTwoDFid(Complexf *fid, long npts, long stride, TwoDMode mode,
+                     unsigned nincrements, float dwell1, unsigned nlines, float dwell,
+                     const float *amplitude, const float *freq, const float *damp,
+                     const float *phase, const float *freq1, const float *damp1, float de);
+
+/* Make a 2D data set with makeTwoDFid() as the blocks of one serial ProNmr
+   file, mapped into memory by ProNmrMap and written in place in block
+   order.  params gives the number of points (si), where the data start
+   (offsets[DAT]) and the F1 parameters sf1 and o11; nrecs is set to the
+   number of FIDs, in2d to dwell1 and the HYPER_COMPLEX status bit for
+   STATES and ECHO_ANTIECHO. */
+    void makeTwoDProNmr(const std::string& name, const ProNmr& params, TwoDMode mode,
+                        unsigned nincrements, float dwell1, unsigned nlines, float dwell,
+                        const float *amplitude, const float *freq, const float *damp,
+                        const float *phase, const float *freq1, const float *damp1,
+                        float de);
+
+/**
+        Generate an arrayed experiment: nexp FIDs of npts points, FID n
+        starting at fid[n * stride] and following law with array value
+        values[n].  The arrays must have been initialised with at least
+        nlines entries.
+
+        law          -- how the lines change from one experiment to the next
+        nexp         -- number of experiments
+        values       -- array value of each experiment (vd list)
+        dwell, amplitude, freq, damp, phase, de
+                     -- as for makeSimFid()
+        constant     -- the per line constant of the law
+
+        For the laws that change only amplitudes the DecayKernel of the
+        lines is set up once and scaled for each experiment.  The
+        experiments are made in parallel, each on one thread, so the
+        result does not depend on the thread count.
+*/
+    void makeSeriesFid(Complexf *fid, long npts, long stride, SeriesLaw law, unsigned nexp,
+                       const float *values, unsigned nlines, float dwell,
+                       const float *amplitude, const float *freq, const float *damp,
+                       const float *phase, const float *constant, float de);
+
+/* Make an arrayed experiment with makeSeriesFid() as the blocks of one
+   serial ProNmr file, mapped into memory by ProNmrMap and written in place
+   in one pass.  params gives the number of points (si) and where the data
+   start (offsets[DAT]); nrecs is set to nexp and vd to the first array
+   value.  The whole list goes to name + ".vd", one value per line.
+   Throws std::runtime_error if a file cannot be written. */
+    void makeSeriesProNmr(const std::string& name, const ProNmr& params, SeriesLaw law,
+                          unsigned nexp, const float *values, unsigned nlines, float dwell,
+                          const float *amplitude, const float *freq, const float *damp,
+                          const float *phase, const float *constant, float de);
+
+/* The noise is drawn from a Philox counter based generator.  Every deviate
+   is a function of the seed, the spectrum index and the sample number
+   alone, so noise can be generated on any number of threads and the noise
+   of any one spectrum reproduced without generating those before it.
+   Gaussian deviates come from GaussianNoise. */
+
+// seed of the noise generator, 1 by default
+    void setSeed(uint64_t seed);
+    uint64_t seed() const;
 
-// generate a uniform deviate in the range [0, 1]
+// index of the spectrum being generated, 0 by default.  Setting it also
+// restarts the sequence returned by uniformDeviate() and gaussianDeviate().
+    void setSpectrum(uint32_t spectrum);
+    uint32_t spectrum() const;
+
+// generate the next uniform deviate in the range [0, 1)
     float uniformDeviate();
 
-// generate a gaussian deviate with mean and variance
+// generate uniform deviate number draw for the given sample in the range [0, 1)
+    float uniformDeviate(uint64_t sample, uint32_t draw) const;
+
+// generate the next gaussian deviate with mean and variance
     float gaussianDeviate(float mean, float variance);
 
+// generate gaussian deviate number index of one of several independent
+// streams, with mean and variance
+    float gaussianDeviate(float mean, float variance, uint64_t index, uint32_t stream) const;
+
 // add noise with standard deviation fNoiseLevel.
     void addNoise(FloatArray& fid, float noiseLevel);
 
 // add noise with standard deviation fNoiseLevel.
     void addNoise(ComplexfArray& Fid, float noiseLevel);
 
+// add noise with standard deviation fNoiseLevel to count floats.
+    void addNoise(float *data, long count, float noiseLevel);
+
+// noise levels used by sweep().  By default 0, 0.01, 0.02, 0.04 ... 2.56,
+// one spectrum each.
+    void setNoiseTable(const std::vector<NoiseLevel>& table);
+    const std::vector<NoiseLevel>& noiseTable() const;
+
+/* Read a noise table from a text file with one level per line: the
+   standard deviation, optionally followed by the number of replicates
+   (1 if absent).  Throws std::runtime_error if the file cannot be read. */
+    static std::vector<NoiseLevel> readNoiseTable(const std::string& fName);
+
+/* Add noise at every level of the noise table to copies of the noiseless
+   FID clean, which is computed only once by the caller, and pass each
+   copy to sink, level by level and replicate by replicate.
+
+   Spectrum n of the sweep gets the noise of spectrum index spectrum() + n,
+   so every spectrum has independent noise that can be reproduced on its
+   own.  Small FIDs are made several at a time on separate threads and
+   large ones with all threads each, but sink is always called from the
+   calling thread and in order. */
+    void sweep(const ComplexfArray& clean, const SweepSink& sink);
+
+/* The same as a pipeline, so that making and formatting spectra overlaps
+   with writing them.  Worker threads each take a spectrum, add its noise
+   to a copy of clean and pass it to format; write is called from the
+   calling thread, in order, with each spectrum and its output once the
+   ones before it have been written.  The FID and output buffers are
+   recycled, PIPELINE_BUFFERS (in DataGenerator.cpp) per worker, so the
+   workers wait rather than run ahead when the writer falls behind.  An
+   exception from format or write stops the sweep and is rethrown here. */
+    void sweep(const ComplexfArray& clean, const SweepFormatter& format,
+               const SweepWriter& write);
+
+/* Make the spectra of sweep() as the blocks of one serial ProNmr file,
+   mapped into memory by ProNmrMap.  params gives the number of points
+   (si) and where the data start (offsets[DAT]); nrecs is set to the number
+   of spectra.  The noiseless FID is synthesised straight into the first
+   block and copied from there into the others before their noise is
+   added, so no FID is held outside the file's own pages. */
+    void sweepProNmr(const std::string& name, const ProNmr& params, unsigned nlines,
+                     float dwell, const float *amplitude, const float *freq,
+                     const float *damp, const float *phase, float de);
+
+/* Make the spectra of sweep() as a RANGER file in constant memory, for
+   FIDs of any length.  params gives the number of points and the
+   acquisition parameters; the sample type is set to the complex type of
+   its storage and nspectra to the number of spectra.  The noiseless FID is
+   made by DecayKernel STREAM_POINTS (in DataGenerator.cpp) points at a
+   time, each piece starting from the closed form of every line, and each
+   piece gets the noise of every spectrum and is written to its place in
+   the file before the next is made.  The pieces are held in the precision
+   of the sums, so with DOUBLE_PRECISION the samples are rounded only once,
+   to the storage.  With SINGLE_PRECISION the spectra are bitwise the same
+   as those of sweep() on a FID made by makeSimFid() with the DIRECT
+   engine; NufftSynth needs the whole FID at once and is not used. */
+    void streamRanger(const std::string& name, const RangerFile::Params& params,
+                      unsigned nlines, float dwell, const float *amplitude, const float *freq,
+                      const float *damp, const float *phase, float de);
+
+// throughput of the synthesis of the last makeSimFid() or streamRanger() call
+// in samples * lines per second
+    double synthesisRate() const;
+
+// select how the decay kernels compute each sample; PHASOR by default
+    void setSynthesisMode(SynthesisMode mode);
+    SynthesisMode synthesisMode() const;
+
+// select the makeSimFid() algorithm; AUTOMATIC by default.  The engine is
+// chosen without regard to the thread count so that the result does not
+// depend on it.
+    void setSynthesisEngine(SynthesisEngine engine);
+    SynthesisEngine synthesisEngine() const;
+
+// error allowed in NUFFT synthesis relative to each line's amplitude,
+// 1e-6 by default
+    void setNufftTolerance(double tolerance);
+    double nufftTolerance() const;
+
+// select the precision of the decay kernels; SINGLE_PRECISION by default.
+// NufftSynth's accuracy is set by setNufftTolerance() instead.
+    void setPrecision(Precision precision);
+    Precision precision() const;
+
+// select how the RANGER files written by generate() store their samples;
+// RangerFile::FLOAT32 by default
+    void setStorage(RangerFile::Storage storage);
+    RangerFile::Storage storage() const;
+
+/* The scale of RangerFile::SCALED_INT32 samples of an FID of npts points
+   with the noise of the noise table: full scale is the largest magnitude
+   the lines can reach, the sum of their amplitudes at the time each is
+   largest, plus 7.5 times the largest standard deviation of the table,
+   which GaussianNoise never exceeds.  It depends only on the lines and the
+   table, so every file of a sweep has the same scale. */
+    double storageScale(long npts, unsigned nlines, float dwell, const float *amplitude,
+                        const float *damp, float de) const;
+
+// threads used by the make*Fid() functions, 0 for all hardware threads
+// (the default).  The results are the same for any number of threads.
+    void setThreads(unsigned nthreads);
+    unsigned threads() const;
+
 private:
+    template <typename Real>
+    void addNoise(Real *data, uint64_t first, long count, float noiseLevel,
+                  uint32_t spectrum, unsigned nthreads) const;
+    std::vector<std::pair<unsigned, unsigned>> sweepSpectra() const;
+    template <typename Real>
+    void addSweepNoise(std::complex<Real> *fid, uint64_t first, long npts, size_t n,
+                       unsigned level, unsigned nthreads) const;
+    template <typename Real>
+    void streamSpectra(RangerWriter& writer, const std::vector<std::pair<unsigned, unsigned>>&
+                       spectra, const DecayKernel& kernel, unsigned nlines);
+    RangerFile::Params rangerParams(uint64_t npoints, uint32_t nspectra, double sf,
+                                    double o1) const;
+
+    // the direct sum of the lines into the npts samples of fid, recorded as ACQUISITION
+    template <Acquisition ACQUISITION, typename Sample>
+    void addLines(Sample *fid, long npts, unsigned nlines, float dwell, const float *amplitude,
+                  const float *freq, const float *damp, const float *phase, float de,
+                  bool zerofid);
+
     InputSpecs mSpecs;
+    SynthesisMode mSynthesisMode;
+    Precision mPrecision;
+    RangerFile::Storage mStorage;
+    SynthesisEngine mSynthesisEngine;
+    double mNufftTolerance;
+    unsigned mThreads;
+    uint64_t mSeed;
+    uint32_t mSpectrum;
+    uint64_t mPosition;     // of the next sequential deviate
+    std::vector<NoiseLevel> mNoiseTable;
+    double mSynthesisRate;
 };
 
 #endif // DATAGENERATOR_H
@@ -0,0 +1,175 @@
+//
+//  DecayKernel.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "DecayKernel.h"
+#include "Kernels.h"
+
+#include <cmath>
+
+DecayKernel::DecayKernel(unsigned nlines, float dwell, const float *amplitude,
+                         const float *freq, const float *damp, const float *phase, float de,
+                         DataGenerator::SynthesisMode mode, DataGenerator::Precision precision)
+{
+    const CpuDispatch::Isa isa = CpuDispatch::active();
+    const unsigned lanes = CpuDispatch::lanes(isa);
+    const unsigned npadded = (nlines + lanes - 1) / lanes * lanes;
+
+    mLines.mode = mode;
+    mLines.precision = precision;
+    mLines.isa = isa;
+    mLines.nlines = nlines;
+    mLines.npadded = npadded;
+    mLines.byTime = nlines <= lanes / 2;
+    mLines.amplitude.assign(npadded, 0.0);
+    mLines.angle.assign(npadded, 0.0);
+    mLines.dwAngle.assign(npadded, 0.0);
+    mLines.dwDamp.assign(npadded, 0.0);
+
+    for (unsigned i = 0; i < nlines; i++)
+    {
+        // convert input parameters to radians
+        double omega = 2.0 * M_PI * freq[i];
+
+        mLines.amplitude[i] = amplitude[i] * std::exp(double(damp[i]) * de);
+        mLines.angle[i] = omega * de + phase[i] * M_PI / 180.0;
+        mLines.dwAngle[i] = omega * dwell;
+        mLines.dwDamp[i] = double(damp[i]) * dwell;
+    }
+
+    if (precision == DataGenerator::DOUBLE_PRECISION)
+        setSteps(mLines.doubleSteps);
+    else
+        setSteps(mLines.singleSteps);
+}
+
+// the steps computed in double and rounded to Real
+template <typename Real>
+void DecayKernel::setSteps(Steps<Real>& steps) const
+{
+    const Lines& lines = mLines;
+    const unsigned lanes = CpuDispatch::lanes(lines.isa);
+
+    steps.dwAngle.assign(lines.npadded, 0.0);
+    steps.dwDecay.assign(lines.npadded, 0.0);
+    steps.re.assign(lines.npadded, 0.0);
+    steps.im.assign(lines.npadded, 0.0);
+
+    for (unsigned i = 0; i < lines.nlines; i++)
+    {
+        steps.dwAngle[i] = Real(lines.dwAngle[i]);
+        steps.dwDecay[i] = Real(std::exp(lines.dwDamp[i]));
+
+        std::complex<double> step = std::exp(std::complex<double>(lines.dwDamp[i],
+                                                                  lines.dwAngle[i]));
+        steps.re[i] = Real(step.real());
+        steps.im[i] = Real(step.imag());
+
+        if (lines.byTime)
+        {
+            for (unsigned k = 0; k < lanes; k++)
+            {
+                std::complex<double> power = std::exp(std::complex<double>(lines.dwDamp[i],
+                                                                           lines.dwAngle[i])
+                                                      * double(k));
+                steps.laneDecay.push_back(Real(std::exp(lines.dwDamp[i] * k)));
+                steps.laneRe.push_back(Real(power.real()));
+                steps.laneIm.push_back(Real(power.imag()));
+            }
+            std::complex<double> power = std::exp(std::complex<double>(lines.dwDamp[i],
+                                                                       lines.dwAngle[i])
+                                                  * double(lanes));
+            steps.vectorDecay.push_back(Real(std::exp(lines.dwDamp[i] * lanes)));
+            steps.vectorRe.push_back(Real(power.real()));
+            steps.vectorIm.push_back(Real(power.imag()));
+        }
+    }
+}
+
+DecayKernel DecayKernel::scaled(const double *scale) const
+{
+    DecayKernel kernel(*this);
+    for (unsigned i = 0; i < mLines.nlines; i++)
+        kernel.mLines.amplitude[i] *= scale[i];
+    return kernel;
+}
+
+unsigned DecayKernel::nLines() const
+{
+    return mLines.nlines;
+}
+
+unsigned DecayKernel::nChunks() const
+{
+    return (mLines.npadded + CHUNK_LINES - 1) / CHUNK_LINES;
+}
+
+void DecayKernel::accumulate(Complexf *fid, long first, long count, unsigned nthreads) const
+{
+    accumulate<DataGenerator::SIMULTANEOUS>(fid, first, count, nthreads);
+}
+
+void DecayKernel::accumulateSamples(Complexf *out, long first, long count,
+                                    unsigned nthreads) const
+{
+    accumulateSamples<DataGenerator::SIMULTANEOUS>(out, first, count, nthreads);
+}
+
+template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+void DecayKernel::accumulate(Sample *fid, long first, long count, unsigned nthreads) const
+{
+    accumulateSamples<ACQUISITION>(fid + first, first, count, nthreads);
+}
+
+// the sums of the instruction set the steps were laid out for
+template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+void DecayKernel::accumulateSamples(Sample *out, long first, long count,
+                                    unsigned nthreads) const
+{
+    switch (mLines.isa)
+    {
+    case CpuDispatch::AVX512:
+        avx512::sumDecays<ACQUISITION>(mLines, out, first, count, nthreads);
+        break;
+    case CpuDispatch::AVX2:
+        avx2::sumDecays<ACQUISITION>(mLines, out, first, count, nthreads);
+        break;
+    default:
+        baseline::sumDecays<ACQUISITION>(mLines, out, first, count, nthreads);
+        break;
+    }
+}
+
+// the acquisitions and sample types DataGenerator and IncrementalSynth use
+template void DecayKernel::accumulate<DataGenerator::SIMULTANEOUS, Complexf>(
+    Complexf *, long, long, unsigned) const;
+template void DecayKernel::accumulate<DataGenerator::SIMULTANEOUS, Complexd>(
+    Complexd *, long, long, unsigned) const;
+template void DecayKernel::accumulate<DataGenerator::SEQUENTIAL, Float>(
+    Float *, long, long, unsigned) const;
+template void DecayKernel::accumulate<DataGenerator::SINGLE_CHANNEL, Float>(
+    Float *, long, long, unsigned) const;
+template void DecayKernel::accumulateSamples<DataGenerator::SIMULTANEOUS, Complexf>(
+    Complexf *, long, long, unsigned) const;
+template void DecayKernel::accumulateSamples<DataGenerator::SEQUENTIAL, Float>(
+    Float *, long, long, unsigned) const;
+template void DecayKernel::accumulateSamples<DataGenerator::SINGLE_CHANNEL, Float>(
+    Float *, long, long, unsigned) const;
+template void DecayKernel::accumulateSamples<DataGenerator::SIMULTANEOUS, Complexd>(
+    Complexd *, long, long, unsigned) const;
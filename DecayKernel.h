@@ -0,0 +1,184 @@
+//
+//  DecayKernel.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DECAYKERNEL_H
+#define DECAYKERNEL_H
+
+#include "CpuDispatch.h"
+#include "DataGenerator.h"
+
+#include <vector>
+
+/* Sums many exponentially decaying lines into a complex FID in one pass.
+
+   The line parameters are held as structure-of-arrays and as many lines
+   as a vector register of the instruction set chosen at startup has float
+   lanes (VEC_LANES, see CpuDispatch) are evaluated side by side.  Lines
+   are taken four vectors at a time and each FID sample is read and written
+   once per group, rather than once per line as with repeated
+   addExpDecaySim() calls.  The sums themselves are in DecayKernelSums.h,
+   compiled once for each instruction set.
+
+   Time is cut into segments of SEGMENT_POINTS samples aligned on absolute
+   sample numbers.  At the start of each segment the decay and angle of
+   every line are recomputed in double precision from their closed forms,
+   so errors cannot accumulate from one segment to the next and any range
+   of samples can be computed on its own with the same result as when it
+   is part of a whole FID.
+
+   Lines are also cut into chunks of CHUNK_LINES.  Each chunk is summed on
+   its own and the chunk sums are added to the FID in chunk order, so the
+   result does not depend on whether the work was split over time, over
+   chunks or not at all: it is bitwise the same for any thread count.  It
+   does depend, by rounding, on the instruction set, whose lanes split the
+   sum differently; a kernel keeps using the one it was made for.
+
+   Within a segment DataGenerator::TRIGONOMETRIC evaluates the angle and a
+   vector sine and cosine for every sample while DataGenerator::PHASOR
+   multiplies each line's phasor by its per-dwell step.  With the AVX-512
+   kernels, 200 to 2000 lines and 32K points PHASOR runs at about 1.7e9 to
+   2e9 samples*lines/s against 0.85e9 to 1e9 for TRIGONOMETRIC.
+
+   The PHASOR step exp((damp + i*omega) * dwell) is computed in double and
+   rounded to float, giving a relative error of at most 2^-24 * sqrt(2) per
+   step, and each float complex multiplication adds at most another 2^-22.
+   Both grow linearly within a segment, so after n steps the error relative
+   to the line's current magnitude is below about 4.7 * n * 2^-24, or 7e-5
+   at the end of a segment; the largest error measured over 50 lines of 64K
+   points was 1.1e-5.
+
+   With DataGenerator::DOUBLE_PRECISION the steps are kept and the sums
+   made in double, in vectors of as many lanes.  Over 300 lines of 64K
+   points the largest error was then 2e-13 of the sum of the amplitudes,
+   against 5e-7 (PHASOR) and 1.4e-6 (TRIGONOMETRIC) in float, before the
+   final rounding to the sample type.
+
+   The sums are compiled for each DataGenerator::Acquisition, synthesis
+   mode and precision, which are chosen once per call of accumulate(), and
+   separately from the type of the samples they are stored in;
+   SINGLE_CHANNEL leaves the imaginary parts out of the sums altogether.
+
+   Up to VEC_LANES / 2 lines would leave most lanes empty, so the lanes take
+   VEC_LANES consecutive samples of one line instead, stepped a whole
+   vector of samples at a time.  This is the path of a single line added
+   by addExpDecaySim(), addExpDecaySeq() or addExpDecaySin().
+
+   Lines that have decayed to nothing (see audible() in DecayKernelSums.h) are
+   skipped for the rest of a segment; stepping them on into denormals cut
+   the throughput of both modes by an order of magnitude. */
+class DecayKernel
+{
+public:
+    enum
+    {
+        CHUNK_LINES = 1024,
+        SEGMENT_POINTS = 256
+    };
+
+    /**
+        nlines       -- number of lines in the arrays
+        dwell        -- dwell period (s)
+        amplitude    -- amplitude (peak areas) of each line (== value at time == 0)
+        freq         -- frequency (rotating frame) of each line (Hz)
+        damp         -- damping factor of each line (1 / s)
+        phase        -- phase of each line at time == 0 (degrees)
+        de           -- pre-acq delay (s)
+        mode         -- how each sample is evaluated
+        precision    -- the precision of the steps and sums
+    */
+    DecayKernel(unsigned nlines, float dwell, const float *amplitude, const float *freq,
+                const float *damp, const float *phase, float de,
+                DataGenerator::SynthesisMode mode = DataGenerator::PHASOR,
+                DataGenerator::Precision precision = DataGenerator::SINGLE_PRECISION);
+
+    /** Adds the sum of all lines, recorded as ACQUISITION, to
+        fid[first] .. fid[first + count - 1].  fid points at sample 0 of the
+        whole FID, whose samples are Complexf or Complexd for SIMULTANEOUS
+        and Float for SEQUENTIAL and SINGLE_CHANNEL.  With nthreads > 1 the
+        work is split over blocks of time when there are enough samples and
+        over chunks of lines otherwise. */
+    template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+    void accumulate(Sample *fid, long first, long count, unsigned nthreads = 1) const;
+
+    /** The same but adds sample first to out[0], so a long FID can be made
+        a piece at a time in a small buffer.  The pieces are bitwise the
+        same as the samples of a whole FID. */
+    template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+    void accumulateSamples(Sample *out, long first, long count, unsigned nthreads = 1) const;
+
+    // the same recorded SIMULTANEOUS
+    void accumulate(Complexf *fid, long first, long count, unsigned nthreads = 1) const;
+    void accumulateSamples(Complexf *out, long first, long count, unsigned nthreads = 1) const;
+
+    /** A copy in which line i has scale[i] times the amplitude it has in
+        this one.  Nothing else depends on the amplitudes, so the per line
+        steps and phases are copied rather than computed again. */
+    DecayKernel scaled(const double *scale) const;
+
+    unsigned nLines() const;
+    unsigned nChunks() const;
+
+    // the per line steps in the precision of the sums
+    template <typename Real>
+    struct Steps
+    {
+        std::vector<Real> dwAngle;      // evolution per dwell (rad)
+        std::vector<Real> dwDecay;      // decay per dwell
+        std::vector<Real> re;           // exp((damp + i * omega) * dwell)
+        std::vector<Real> im;
+
+        // lanes per line when the lanes take samples: step^k for lane k
+        // (decay and phasor) and step^lanes per vector of samples
+        std::vector<Real> laneDecay;
+        std::vector<Real> laneRe;
+        std::vector<Real> laneIm;
+        std::vector<Real> vectorDecay;
+        std::vector<Real> vectorRe;
+        std::vector<Real> vectorIm;
+    };
+
+    // the lines as the sums of DecayKernelSums.h read them
+    struct Lines
+    {
+        DataGenerator::SynthesisMode mode;
+        DataGenerator::Precision precision;
+        CpuDispatch::Isa isa;           // whose sums are used
+        unsigned nlines;
+        unsigned npadded;               // with silent lines to whole vectors of isa
+        bool byTime;                    // the lanes take samples rather than lines
+
+        std::vector<double> amplitude;  // amplitude * exp(damp * de)
+        std::vector<double> angle;      // freq * de + phase (rad)
+        std::vector<double> dwAngle;    // evolution per dwell (rad)
+        std::vector<double> dwDamp;     // log of decay per dwell
+
+        // the steps of the precision in use; the other is left empty
+        Steps<float> singleSteps;
+        Steps<double> doubleSteps;
+    };
+
+private:
+    template <typename Real>
+    void setSteps(Steps<Real>& steps) const;
+
+    Lines mLines;
+};
+
+#endif // DECAYKERNEL_H
@@ -0,0 +1,460 @@
+//
+//  DecayKernelSums.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DECAYKERNELSUMS_H
+#define DECAYKERNELSUMS_H
+
+#include "Kernels.h"
+#include "Parallel.h"
+#include "VecMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* The sums of DecayKernel, for the instruction set of the file that
+   includes this one (see VecMath.h).  They were its private members; only
+   the lines they read have stayed behind in DecayKernel::Lines. */
+namespace VEC_ISA
+{
+
+enum
+{
+    GROUP_VECTORS = 4,
+    GROUP_LINES = GROUP_VECTORS * VEC_LANES,
+    SEGMENT_POINTS = DecayKernel::SEGMENT_POINTS,
+    CHUNK_LINES = DecayKernel::CHUNK_LINES
+};
+
+inline const DecayKernel::Steps<float>& steps(const DecayKernel::Lines& lines, float)
+{
+    return lines.singleSteps;
+}
+
+inline const DecayKernel::Steps<double>& steps(const DecayKernel::Lines& lines, double)
+{
+    return lines.doubleSteps;
+}
+
+/* Lines that have decayed this far are left out of the sum.  They are far
+   below the rounding error of the samples they would be added to and
+   stepping them on would soon produce denormals, which are very slow. */
+inline double audible(double magnitude, double amplitude)
+{
+    const double MIN_MAGNITUDE = 1.0e-30;
+    const double MIN_RELATIVE = 1.0e-20;
+
+    double size = std::abs(magnitude);
+    if (size < MIN_MAGNITUDE || size < MIN_RELATIVE * std::abs(amplitude))
+        return 0.0;
+    return magnitude;
+}
+
+// decay and angle (reduced to [-pi, pi]) of nlines lines at the given sample
+template <typename Real>
+void startSegment(const DecayKernel::Lines& lines, long sample, unsigned line, unsigned nlines,
+                  Real *magnitude, Real *angle)
+{
+    for (unsigned i = line; i < line + nlines; i++)
+    {
+        magnitude[i - line] = Real(audible(lines.amplitude[i] * std::exp(lines.dwDamp[i] * sample),
+                                           lines.amplitude[i]));
+        angle[i - line] = Real(std::remainder(lines.angle[i] + lines.dwAngle[i] * sample,
+                                              2.0 * M_PI));
+    }
+}
+
+/* How each acquisition turns the sum z = re + i*im of the lines at sample
+   n, in the precision of the sums, into a sample of the FID, and whether it
+   needs Im(z) at all. */
+template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+struct Acquire;
+
+template <typename Sample>
+struct Acquire<DataGenerator::SIMULTANEOUS, Sample>
+{
+    static const bool IMAGINARY = true;
+
+    template <typename Real>
+    static Sample sample(long, Real re, Real im)
+    {
+        return Sample(re, im);
+    }
+};
+
+template <typename Sample>
+struct Acquire<DataGenerator::SEQUENTIAL, Sample>
+{
+    static const bool IMAGINARY = true;
+
+    // the "imaginary" channel is negated, as Bruker does
+    template <typename Real>
+    static Sample sample(long n, Real re, Real im)
+    {
+        return Sample(n % 2 == 0 ? re : -im);
+    }
+};
+
+template <typename Sample>
+struct Acquire<DataGenerator::SINGLE_CHANNEL, Sample>
+{
+    static const bool IMAGINARY = false;
+
+    template <typename Real>
+    static Sample sample(long, Real re, Real)
+    {
+        return Sample(re);
+    }
+};
+
+template <typename Real, bool IMAGINARY>
+void accumulateTrig(const DecayKernel::Lines& lines, typename Vec<Real>::Type *accRe,
+                    typename Vec<Real>::Type *accIm, long segment, long jEnd, unsigned line,
+                    unsigned nvec)
+{
+    typedef typename Vec<Real>::Type VecR;
+    const DecayKernel::Steps<Real>& step = steps(lines, Real());
+
+    Real magnitude[GROUP_LINES];
+    Real angle[GROUP_LINES];
+
+    startSegment(lines, segment, line, nvec * VEC_LANES, magnitude, angle);
+
+    VecR decay[GROUP_VECTORS], dwDecay[GROUP_VECTORS];
+    VecR angle0[GROUP_VECTORS], dwAngle[GROUP_VECTORS];
+    for (unsigned v = 0; v < nvec; v++)
+    {
+        decay[v] = vecLoad(&magnitude[v * VEC_LANES]);
+        angle0[v] = vecLoad(&angle[v * VEC_LANES]);
+        dwDecay[v] = vecLoad(&step.dwDecay[line + v * VEC_LANES]);
+        dwAngle[v] = vecLoad(&step.dwAngle[line + v * VEC_LANES]);
+    }
+
+    /* off we go */
+    for (long j = 0; j < jEnd; j++)
+    {
+        VecR re = accRe[j], im = IMAGINARY ? accIm[j] : VecR{};
+        for (unsigned v = 0; v < nvec; v++)
+        {
+            VecR s, c;
+            vecSinCos(angle0[v] + dwAngle[v] * Real(j), s, c);
+            re += decay[v] * c;
+            if (IMAGINARY)
+                im += decay[v] * s;
+            decay[v] *= dwDecay[v];
+        }
+        accRe[j] = re;
+        if (IMAGINARY)
+            accIm[j] = im;
+    }
+}
+
+template <typename Real, bool IMAGINARY>
+void accumulatePhasor(const DecayKernel::Lines& lines, typename Vec<Real>::Type *accRe,
+                      typename Vec<Real>::Type *accIm, long segment, long jEnd, unsigned line,
+                      unsigned nvec)
+{
+    typedef typename Vec<Real>::Type VecR;
+    const DecayKernel::Steps<Real>& step = steps(lines, Real());
+
+    Real magnitude[GROUP_LINES];
+    Real angle[GROUP_LINES];
+    Real re0[GROUP_LINES];
+    Real im0[GROUP_LINES];
+
+    startSegment(lines, segment, line, nvec * VEC_LANES, magnitude, angle);
+    for (unsigned i = 0; i < nvec * VEC_LANES; i++)
+    {
+        re0[i] = magnitude[i] * std::cos(angle[i]);
+        im0[i] = magnitude[i] * std::sin(angle[i]);
+    }
+
+    VecR zRe[GROUP_VECTORS], zIm[GROUP_VECTORS];
+    VecR stepRe[GROUP_VECTORS], stepIm[GROUP_VECTORS];
+    for (unsigned v = 0; v < nvec; v++)
+    {
+        zRe[v] = vecLoad(&re0[v * VEC_LANES]);
+        zIm[v] = vecLoad(&im0[v * VEC_LANES]);
+        stepRe[v] = vecLoad(&step.re[line + v * VEC_LANES]);
+        stepIm[v] = vecLoad(&step.im[line + v * VEC_LANES]);
+    }
+
+    /* off we go */
+    for (long j = 0; j < jEnd; j++)
+    {
+        VecR re = accRe[j], im = IMAGINARY ? accIm[j] : VecR{};
+        for (unsigned v = 0; v < nvec; v++)
+        {
+            re += zRe[v];
+            if (IMAGINARY)
+                im += zIm[v];
+            VecR r = zRe[v] * stepRe[v] - zIm[v] * stepIm[v];
+            zIm[v] = zRe[v] * stepIm[v] + zIm[v] * stepRe[v];
+            zRe[v] = r;
+        }
+        accRe[j] = re;
+        if (IMAGINARY)
+            accIm[j] = im;
+    }
+}
+
+/* Sums of the lines for samples segment .. segment + jEnd - 1 (jEnd rounded
+   up to whole vectors) in re[] and im[], with the lanes taking consecutive
+   samples of a line.  The start of every vector of samples follows from
+   the one before by a single step of VEC_LANES dwells. */
+template <typename Real, bool IMAGINARY, DataGenerator::SynthesisMode MODE>
+void sumByTime(const DecayKernel::Lines& lines, Real *re, Real *im, long segment, long jEnd)
+{
+    typedef typename Vec<Real>::Type VecR;
+    const DecayKernel::Steps<Real>& step = steps(lines, Real());
+    const long nvec = (jEnd + VEC_LANES - 1) / VEC_LANES;
+
+    VecR sumRe[SEGMENT_POINTS / VEC_LANES] = {};
+    VecR sumIm[SEGMENT_POINTS / VEC_LANES] = {};
+
+    for (unsigned line = 0; line < lines.nlines; line++)
+    {
+        Real magnitude, angle;
+        startSegment(lines, segment, line, 1, &magnitude, &angle);
+        if (magnitude == Real(0))
+            continue;
+
+        const Real *lane = &step.laneDecay[size_t(line) * VEC_LANES];
+        if (MODE == DataGenerator::PHASOR)
+        {
+            const Real re0 = magnitude * std::cos(angle);
+            const Real im0 = magnitude * std::sin(angle);
+            const VecR laneRe = vecLoad(&step.laneRe[size_t(line) * VEC_LANES]);
+            const VecR laneIm = vecLoad(&step.laneIm[size_t(line) * VEC_LANES]);
+            const Real stepRe = step.vectorRe[line], stepIm = step.vectorIm[line];
+
+            VecR zRe = re0 * laneRe - im0 * laneIm;
+            VecR zIm = re0 * laneIm + im0 * laneRe;
+            for (long v = 0; v < nvec; v++)
+            {
+                sumRe[v] += zRe;
+                if (IMAGINARY)
+                    sumIm[v] += zIm;
+                VecR r = zRe * stepRe - zIm * stepIm;
+                zIm = zRe * stepIm + zIm * stepRe;
+                zRe = r;
+            }
+        }
+        else
+        {
+            VecR j0;
+            for (unsigned k = 0; k < VEC_LANES; k++)
+                j0[k] = Real(k);
+
+            const Real dwAngle = step.dwAngle[line];
+            const Real stepDecay = step.vectorDecay[line];
+            VecR decay = magnitude * vecLoad(lane);
+            for (long v = 0; v < nvec; v++)
+            {
+                VecR s, c;
+                vecSinCos(angle + dwAngle * (j0 + Real(v * VEC_LANES)), s, c);
+                sumRe[v] += decay * c;
+                if (IMAGINARY)
+                    sumIm[v] += decay * s;
+                decay *= stepDecay;
+            }
+        }
+    }
+
+    for (long v = 0; v < nvec; v++)
+    {
+        vecStore(&re[v * VEC_LANES], sumRe[v]);
+        if (IMAGINARY)
+            vecStore(&im[v * VEC_LANES], sumIm[v]);
+    }
+}
+
+/* Sum of the lines in one chunk for samples first .. first + count - 1,
+   added to or stored in out[0] .. out[count - 1]. */
+template <DataGenerator::Acquisition ACQUISITION, DataGenerator::SynthesisMode MODE,
+          typename Real, typename Sample>
+void sumChunk(const DecayKernel::Lines& lines, Sample *out, long first, long count,
+              unsigned chunk, bool add)
+{
+    typedef Acquire<ACQUISITION, Sample> Acquisition;
+    typedef typename Vec<Real>::Type VecR;
+
+    const long end = first + count;
+    const unsigned lineBegin = chunk * CHUNK_LINES;
+    const unsigned lineEnd = std::min(lineBegin + CHUNK_LINES, lines.npadded);
+
+    // per lane sums of the current segment, reduced once per sample at the end
+    VecR accRe[SEGMENT_POINTS];
+    VecR accIm[SEGMENT_POINTS];
+
+    // the sums of the segment's samples
+    Real re[SEGMENT_POINTS];
+    Real im[SEGMENT_POINTS] = {};
+
+    for (long segment = first - first % SEGMENT_POINTS; segment < end; segment += SEGMENT_POINTS)
+    {
+        const long jBegin = std::max(first - segment, 0L);
+        const long jEnd = std::min(end - segment, long(SEGMENT_POINTS));
+
+        if (lines.byTime)
+        {
+            sumByTime<Real, Acquisition::IMAGINARY, MODE>(lines, re, im, segment, jEnd);
+        }
+        else
+        {
+            for (long j = 0; j < jEnd; j++)
+            {
+                accRe[j] = VecR{};
+                if (Acquisition::IMAGINARY)
+                    accIm[j] = VecR{};
+            }
+
+            for (unsigned line = lineBegin; line < lineEnd; line += GROUP_LINES)
+            {
+                const unsigned nvec = std::min(unsigned(GROUP_LINES), lineEnd - line) / VEC_LANES;
+
+                if (MODE == DataGenerator::PHASOR)
+                    accumulatePhasor<Real, Acquisition::IMAGINARY>(lines, accRe, accIm, segment,
+                                                                   jEnd, line, nvec);
+                else
+                    accumulateTrig<Real, Acquisition::IMAGINARY>(lines, accRe, accIm, segment,
+                                                                 jEnd, line, nvec);
+            }
+
+            for (long j = jBegin; j < jEnd; j++)
+            {
+                re[j] = vecSum(accRe[j]);
+                if (Acquisition::IMAGINARY)
+                    im[j] = vecSum(accIm[j]);
+            }
+        }
+
+        Sample *dest = out + (segment - first);
+        for (long j = jBegin; j < jEnd; j++)
+        {
+            Sample sum = Acquisition::sample(segment + j, re[j], im[j]);
+            if (add)
+                dest[j] += sum;
+            else
+                dest[j] = sum;
+        }
+    }
+}
+
+template <DataGenerator::Acquisition ACQUISITION, DataGenerator::SynthesisMode MODE,
+          typename Real, typename Sample>
+void sumSamples(const DecayKernel::Lines& lines, Sample *out, long first, long count,
+                unsigned nthreads)
+{
+    const long end = first + count;
+    const long nsegments = (count + SEGMENT_POINTS - 1) / SEGMENT_POINTS;
+    const unsigned nchunks = (lines.npadded + CHUNK_LINES - 1) / CHUNK_LINES;
+
+    if (nthreads <= 1 || nsegments < 2)
+    {
+        for (unsigned chunk = 0; chunk < nchunks; chunk++)
+            sumChunk<ACQUISITION, MODE, Real>(lines, out, first, count, chunk, true);
+        return;
+    }
+
+    // Long FIDs: every thread takes whole blocks of time
+    if (nchunks < 2 || nsegments >= 4 * long(nthreads))
+    {
+        const unsigned nblocks = unsigned(std::min(nsegments, 4 * long(nthreads)));
+        parallelFor(nthreads, nblocks, [&](unsigned block)
+        {
+            long blockFirst = first + count * block / nblocks;
+            long blockEnd = first + count * (block + 1) / nblocks;
+            sumSamples<ACQUISITION, MODE, Real>(lines, out + (blockFirst - first), blockFirst,
+                                                blockEnd - blockFirst, 1);
+        });
+        return;
+    }
+
+    /* Many lines: every thread sums whole chunks of lines into its own
+       buffer and the buffers are added to the FID in chunk order, which is
+       the order the serial loop above uses. */
+    const long TILE_POINTS = 16 * SEGMENT_POINTS;
+    std::vector<Sample> partial(size_t(nchunks) * TILE_POINTS);
+
+    for (long tile = first; tile < end; tile += TILE_POINTS)
+    {
+        const long npoints = std::min(TILE_POINTS, end - tile);
+
+        parallelFor(nthreads, nchunks, [&](unsigned chunk)
+        {
+            sumChunk<ACQUISITION, MODE, Real>(lines, &partial[size_t(chunk) * TILE_POINTS], tile,
+                                              npoints, chunk, false);
+        });
+
+        const unsigned nblocks = unsigned(std::min(long(nthreads), npoints));
+        parallelFor(nthreads, nblocks, [&](unsigned block)
+        {
+            long jBegin = npoints * block / nblocks;
+            long jEnd = npoints * (block + 1) / nblocks;
+            for (unsigned chunk = 0; chunk < nchunks; chunk++)
+            {
+                const Sample *sum = &partial[size_t(chunk) * TILE_POINTS];
+                for (long j = jBegin; j < jEnd; j++)
+                    out[tile - first + j] += sum[j];
+            }
+        });
+    }
+}
+
+// the synthesis mode and precision are settled here, once for the whole call
+template <DataGenerator::Acquisition ACQUISITION, typename Sample>
+void sumDecays(const DecayKernel::Lines& lines, Sample *out, long first, long count,
+               unsigned nthreads)
+{
+    const bool phasor = lines.mode == DataGenerator::PHASOR;
+    if (lines.precision == DataGenerator::DOUBLE_PRECISION)
+    {
+        if (phasor)
+            sumSamples<ACQUISITION, DataGenerator::PHASOR, double>(lines, out, first, count,
+                                                                   nthreads);
+        else
+            sumSamples<ACQUISITION, DataGenerator::TRIGONOMETRIC, double>(lines, out, first,
+                                                                          count, nthreads);
+    }
+    else
+    {
+        if (phasor)
+            sumSamples<ACQUISITION, DataGenerator::PHASOR, float>(lines, out, first, count,
+                                                                  nthreads);
+        else
+            sumSamples<ACQUISITION, DataGenerator::TRIGONOMETRIC, float>(lines, out, first,
+                                                                         count, nthreads);
+    }
+}
+
+// the acquisitions and sample types of DecayKernel::accumulateSamples()
+template void sumDecays<DataGenerator::SIMULTANEOUS, Complexf>(
+    const DecayKernel::Lines&, Complexf *, long, long, unsigned);
+template void sumDecays<DataGenerator::SEQUENTIAL, Float>(
+    const DecayKernel::Lines&, Float *, long, long, unsigned);
+template void sumDecays<DataGenerator::SINGLE_CHANNEL, Float>(
+    const DecayKernel::Lines&, Float *, long, long, unsigned);
+template void sumDecays<DataGenerator::SIMULTANEOUS, Complexd>(
+    const DecayKernel::Lines&, Complexd *, long, long, unsigned);
+
+} // namespace VEC_ISA
+
+#endif // DECAYKERNELSUMS_H
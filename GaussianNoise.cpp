@@ -0,0 +1,109 @@
+//
+//  GaussianNoise.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "GaussianNoise.h"
+#include "CpuDispatch.h"
+#include "Kernels.h"
+
+#include <algorithm>
+
+/* Deviates are made BATCH_DEVIATES at a time, in batches aligned on
+   multiples of BATCH_DEVIATES so that no vector of Philox blocks is
+   computed twice. */
+static const long BATCH_DEVIATES = 1024;
+
+/* Counter blocks from here up hold the Gaussian streams; those below are
+   left to the uniform deviates of DataGenerator. */
+static const uint32_t GAUSSIAN_BLOCK = 0x80000000;
+
+GaussianNoise::GaussianNoise(uint64_t seed, uint32_t spectrum, uint32_t stream)
+    : mPhilox(seed), mSpectrum(spectrum), mBlock(GAUSSIAN_BLOCK | stream)
+{
+}
+
+// deviates first .. first + count - 1 by the kernel of the instruction set in use
+void GaussianNoise::generate(uint64_t first, long count, float *normals) const
+{
+    switch (CpuDispatch::active())
+    {
+    case CpuDispatch::AVX512:
+        avx512::gaussianDeviates(mPhilox, mSpectrum, mBlock, first, count, normals);
+        break;
+    case CpuDispatch::AVX2:
+        avx2::gaussianDeviates(mPhilox, mSpectrum, mBlock, first, count, normals);
+        break;
+    default:
+        baseline::gaussianDeviates(mPhilox, mSpectrum, mBlock, first, count, normals);
+        break;
+    }
+}
+
+float GaussianNoise::deviate(uint64_t k) const
+{
+    float normal;
+    generate(k, 1, &normal);
+    return normal;
+}
+
+template <typename Real>
+void GaussianNoise::add(Real *data, uint64_t first, long count, float stdDev) const
+{
+    apply(data, first, count, stdDev, true);
+}
+
+template <typename Real>
+void GaussianNoise::fill(Real *data, uint64_t first, long count, float stdDev) const
+{
+    apply(data, first, count, stdDev, false);
+}
+
+template <typename Real>
+void GaussianNoise::apply(Real *data, uint64_t first, long count, float stdDev, bool add) const
+{
+    float normals[BATCH_DEVIATES];
+    const uint64_t end = first + count;
+    const Real scale = stdDev;
+
+    for (uint64_t batch = first; batch < end; )
+    {
+        const uint64_t batchEnd = std::min(end, (batch / BATCH_DEVIATES + 1) * BATCH_DEVIATES);
+        const long n = long(batchEnd - batch);
+        generate(batch, n, normals);
+
+        Real *dest = data + (batch - first);
+        if (add)
+        {
+            for (long k = 0; k < n; k++)
+                dest[k] += scale * normals[k];
+        }
+        else
+        {
+            for (long k = 0; k < n; k++)
+                dest[k] = scale * normals[k];
+        }
+        batch = batchEnd;
+    }
+}
+
+// the sample types of DataGenerator's FIDs
+template void GaussianNoise::add<float>(float *, uint64_t, long, float) const;
+template void GaussianNoise::add<double>(double *, uint64_t, long, float) const;
+template void GaussianNoise::fill<float>(float *, uint64_t, long, float) const;
+template void GaussianNoise::fill<double>(double *, uint64_t, long, float) const;
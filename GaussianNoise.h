@@ -0,0 +1,79 @@
+//
+//  GaussianNoise.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GAUSSIANNOISE_H
+#define GAUSSIANNOISE_H
+
+#include "Philox.h"
+
+#include <cstdint>
+
+/* Normal deviates in bulk by the Box-Muller transform, a vector of Philox
+   blocks at a time (GaussianNoiseDeviates.h, compiled for each instruction
+   set of CpuDispatch).
+
+   Deviate number k of a stream comes from Philox block k / 4, whose four
+   words make two (radius, angle) pairs.  The radius uniform has 40 bits, the
+   32 of one word and the low 8 of the angle word, so the largest deviate
+   that can be drawn is 7.5 standard deviations; a true Gaussian goes beyond
+   that once in 2e13 draws.  The angle has 24 bits.  Unlike the sum of 20
+   uniforms used before, the shape is Gaussian all the way out, not just
+   near the middle.
+
+   As with Philox itself every deviate depends only on (seed, spectrum,
+   stream, k), so any range can be generated on its own and on any thread,
+   and with any of the instruction sets.
+   With the AVX-512 kernels this is about 30 times faster than the sum of 20
+   Philox uniforms and 90 times faster than the sum of 20 random() calls it
+   replaces (bench/NoiseBench.cpp). */
+class GaussianNoise
+{
+public:
+    /**
+        seed         -- key of the Philox generator
+        spectrum     -- index of the spectrum
+        stream       -- independent stream of deviates, < 2^31
+    */
+    GaussianNoise(uint64_t seed, uint32_t spectrum, uint32_t stream = 0);
+
+    // deviate number k of the stream
+    float deviate(uint64_t k) const;
+
+    /* data[k - first] += stdDev * deviate(k) for k in first .. first + count - 1,
+       for float or double data.  The deviates are floats either way; with
+       double data the products and sums are double. */
+    template <typename Real>
+    void add(Real *data, uint64_t first, long count, float stdDev) const;
+
+    // data[k - first] = stdDev * deviate(k) for k in first .. first + count - 1
+    template <typename Real>
+    void fill(Real *data, uint64_t first, long count, float stdDev) const;
+
+private:
+    void generate(uint64_t first, long count, float *normals) const;
+    template <typename Real>
+    void apply(Real *data, uint64_t first, long count, float stdDev, bool add) const;
+
+    Philox mPhilox;
+    uint32_t mSpectrum;
+    uint32_t mBlock;
+};
+
+#endif // GAUSSIANNOISE_H
@@ -0,0 +1,111 @@
+//
+//  GaussianNoiseDeviates.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GAUSSIANNOISEDEVIATES_H
+#define GAUSSIANNOISEDEVIATES_H
+
+#include "Kernels.h"
+#include "VecMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+/* The Box-Muller transform of GaussianNoise, for the instruction set of
+   the file that includes this one (see VecMath.h).  Contraction into fused
+   multiply-adds is turned off so that every instruction set rounds each
+   deviate the same way: a run gives the same noise on every node. */
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+
+namespace VEC_ISA
+{
+
+// deviates made by one call of gaussianGroup()
+const long GROUP_DEVIATES = 4 * VEC_LANES;
+
+// deviates group * GROUP_DEVIATES .. (group + 1) * GROUP_DEVIATES - 1
+inline void gaussianGroup(const Philox& philox, uint32_t spectrum, uint32_t block,
+                          uint64_t group, float *normals)
+{
+    VecU word[4];
+    for (int lane = 0; lane < VEC_LANES; lane++)
+    {
+        Philox::Block words = philox(group * VEC_LANES + lane, spectrum, block);
+        for (int w = 0; w < 4; w++)
+            word[w][lane] = words.word[w];
+    }
+
+    for (int pair = 0; pair < 2; pair++)
+    {
+        VecU radius = word[2 * pair];
+        VecU angle = word[2 * pair + 1];
+
+        // uniform in (0, 1], rounding may take the largest values to just above 1
+        VecF u = (__builtin_convertvector(radius, VecF)
+                  + (__builtin_convertvector(angle & 0xff, VecF) + 0.5f) * (1.0f / 256.0f))
+                 * (1.0f / 4294967296.0f);
+        u = u < 1.0f ? u : 1.0f;
+        VecF r = vecSqrt(-2.0f * vecLog(u));
+
+        // uniform in [-pi, pi)
+        VecF theta = __builtin_convertvector(angle >> 8, VecF) * float(2.0 * M_PI / 16777216.0)
+                     - float(M_PI);
+        VecF s, c;
+        vecSinCos(theta, s, c);
+
+        VecF x = r * c, y = r * s;
+        for (int lane = 0; lane < VEC_LANES; lane++)
+        {
+            normals[4 * lane + 2 * pair] = x[lane];
+            normals[4 * lane + 2 * pair + 1] = y[lane];
+        }
+    }
+}
+
+void gaussianDeviates(const Philox& philox, uint32_t spectrum, uint32_t block,
+                      uint64_t first, long count, float *normals)
+{
+    float partial[GROUP_DEVIATES];
+    const uint64_t end = first + count;
+
+    for (uint64_t group = first / GROUP_DEVIATES; group * GROUP_DEVIATES < end; group++)
+    {
+        const uint64_t base = group * GROUP_DEVIATES;
+        if (base >= first && base + GROUP_DEVIATES <= end)
+        {
+            gaussianGroup(philox, spectrum, block, group, normals + (base - first));
+        }
+        else
+        {
+            // the ends of the range
+            gaussianGroup(philox, spectrum, block, group, partial);
+            const uint64_t kBegin = std::max(first, base);
+            const uint64_t kEnd = std::min(end, base + GROUP_DEVIATES);
+            for (uint64_t k = kBegin; k < kEnd; k++)
+                normals[k - first] = partial[k - base];
+        }
+    }
+}
+
+} // namespace VEC_ISA
+
+#pragma GCC pop_options
+
+#endif // GAUSSIANNOISEDEVIATES_H
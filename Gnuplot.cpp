@@ -0,0 +1,190 @@
+//
+//  Gnuplot.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Gnuplot.h"
+#include "Instrument.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ostream>
+#include <vector>
+
+/* Collects formatted text and hands it to a stream BUFFER_BYTES at a
+   time, or appends it to a vector that grows as needed. */
+class TextBuffer
+{
+public:
+    explicit TextBuffer(std::ostream& os)
+        : mOs(&os), mOwnBuffer(BUFFER_BYTES), mBuffer(mOwnBuffer), mUsed(0)
+    {
+    }
+
+    explicit TextBuffer(std::vector<char>& text)
+        : mOs(0), mBuffer(text), mUsed(text.size())
+    {
+        mBuffer.resize(std::max(mBuffer.capacity(), mUsed + BUFFER_BYTES));
+    }
+
+    ~TextBuffer()
+    {
+        flush();
+    }
+
+    void put(float value)
+    {
+        if (mUsed + MAX_FLOAT_CHARS > mBuffer.size())
+            makeRoom();
+        char *begin = mBuffer.data() + mUsed;
+        mUsed += std::to_chars(begin, begin + MAX_FLOAT_CHARS, value).ptr - begin;
+    }
+
+    void put(char c)
+    {
+        if (mUsed == mBuffer.size())
+            makeRoom();
+        mBuffer[mUsed++] = c;
+    }
+
+    // writes out the text, or trims the vector to it
+    void flush()
+    {
+        if (mOs != 0)
+        {
+            mOs->write(mBuffer.data(), mUsed);
+            mUsed = 0;
+        }
+        else
+        {
+            mBuffer.resize(mUsed);
+        }
+    }
+
+private:
+    void makeRoom()
+    {
+        if (mOs != 0)
+            flush();
+        else
+            mBuffer.resize(2 * mBuffer.size());
+    }
+
+    static const size_t BUFFER_BYTES = 1 << 16;
+
+    // the shortest form of a float is at most 15 characters: -1.23456789e-38
+    static const size_t MAX_FLOAT_CHARS = 16;
+
+    std::ostream *mOs;
+    std::vector<char> mOwnBuffer;
+    std::vector<char>& mBuffer;
+    size_t mUsed;
+};
+
+static void format(const FloatArray& array, TextBuffer& buffer)
+{
+    ScopedTimer timer(Instrument::FORMAT);
+
+    // We put out the array as a matrix, ignoring dim2 for the time being.
+    for (unsigned iDim0 = 0; iDim0 < array.rows(); iDim0++)
+    {
+        for (unsigned iDim1 = 0; iDim1 < array.cols(); iDim1++)
+        {
+            // across the rows
+            if (iDim1 != 0)
+                buffer.put(' ');
+            buffer.put(array(iDim0, iDim1));
+        }
+        buffer.put('\n');
+    }
+
+    buffer.put('\n');
+}
+
+static void format(const ComplexfArray& array, TextBuffer& buffer)
+{
+    ScopedTimer timer(Instrument::FORMAT);
+
+    // real and imaginary columns for each column of the array
+    for (unsigned iDim0 = 0; iDim0 < array.rows(); iDim0++)
+    {
+        for (unsigned iDim1 = 0; iDim1 < array.cols(); iDim1++)
+        {
+            if (iDim1 != 0)
+                buffer.put(' ');
+            buffer.put(array(iDim0, iDim1).real());
+            buffer.put(' ');
+            buffer.put(array(iDim0, iDim1).imag());
+        }
+        buffer.put('\n');
+    }
+
+    buffer.put('\n');
+}
+
+void writeGnuplot(const FloatArray& array, std::ostream& os)
+{
+    TextBuffer buffer(os);
+    format(array, buffer);
+    buffer.flush();
+    os.flush();
+}
+
+void writeGnuplot(const ComplexfArray& array, std::ostream& os)
+{
+    TextBuffer buffer(os);
+    format(array, buffer);
+    buffer.flush();
+    os.flush();
+}
+
+void formatGnuplot(const FloatArray& array, std::vector<char>& text)
+{
+    TextBuffer buffer(text);
+    format(array, buffer);
+}
+
+void formatGnuplot(const ComplexfArray& array, std::vector<char>& text)
+{
+    TextBuffer buffer(text);
+    format(array, buffer);
+}
+
+void writeGnuplotBinary(const FloatArray& array, std::ostream& os)
+{
+    os.write(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(Float));
+    os.flush();
+}
+
+void writeGnuplotBinary(const ComplexfArray& array, std::ostream& os)
+{
+    os.write(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(Complexf));
+    os.flush();
+}
+
+void formatGnuplotBinary(const FloatArray& array, std::vector<char>& bytes)
+{
+    const char *data = reinterpret_cast<const char *>(array.data());
+    bytes.insert(bytes.end(), data, data + array.size() * sizeof(Float));
+}
+
+void formatGnuplotBinary(const ComplexfArray& array, std::vector<char>& bytes)
+{
+    const char *data = reinterpret_cast<const char *>(array.data());
+    bytes.insert(bytes.end(), data, data + array.size() * sizeof(Complexf));
+}
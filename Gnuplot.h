@@ -0,0 +1,59 @@
+//
+//  Gnuplot.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GNUPLOT_H
+#define GNUPLOT_H
+
+#include "DataGenerator.h"
+
+#include <iosfwd>
+#include <vector>
+
+/* Gnuplot data files.  The text writers format with std::to_chars into a
+   large buffer that goes to the stream in a few big writes, and print the
+   shortest text that reads back as the same float.  A complex FID gets
+   two columns, real and imaginary.
+
+   The binary writers put out the raw floats, interleaved real and
+   imaginary for complex data, which gnuplot reads with
+       plot 'file' binary format="%float%float" using 1 with lines
+   or format="%float" for real data. */
+
+// which of the two createData() (nmrsim.h) writes
+enum GnuplotFormat
+{
+    GNUPLOT_TEXT, GNUPLOT_BINARY
+};
+
+void writeGnuplot(const FloatArray& data, std::ostream& os);
+void writeGnuplot(const ComplexfArray& data, std::ostream& os);
+
+// append the text of writeGnuplot() to text, reusing its capacity
+void formatGnuplot(const FloatArray& data, std::vector<char>& text);
+void formatGnuplot(const ComplexfArray& data, std::vector<char>& text);
+
+void writeGnuplotBinary(const FloatArray& data, std::ostream& os);
+void writeGnuplotBinary(const ComplexfArray& data, std::ostream& os);
+
+// append the bytes of writeGnuplotBinary() to bytes
+void formatGnuplotBinary(const FloatArray& data, std::vector<char>& bytes);
+void formatGnuplotBinary(const ComplexfArray& data, std::vector<char>& bytes);
+
+#endif // GNUPLOT_H
@@ -0,0 +1,156 @@
+//
+//  IncrementalSynth.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "IncrementalSynth.h"
+#include "DecayKernel.h"
+#include "Instrument.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+IncrementalSynth::IncrementalSynth(long npts, float dwell, float de, unsigned nlines,
+                                   const float *amplitude, const float *freq,
+                                   const float *damp, const float *phase,
+                                   DataGenerator::SynthesisMode mode, unsigned nthreads)
+    : mNpts(npts), mDwell(dwell), mDe(de), mMode(mode), mThreads(nthreads),
+      mAmplitude(amplitude, amplitude + nlines), mFreq(freq, freq + nlines),
+      mDamp(damp, damp + nlines), mPhase(phase, phase + nlines),
+      mRebuildInterval(REBUILD_LINES), mChanged(0)
+{
+    if (npts < 0)
+        throw std::invalid_argument("Negative FID size: " + std::to_string(npts));
+    mFid.resize(npts);
+    rebuild();
+}
+
+void IncrementalSynth::update(unsigned nchanged, const unsigned *index,
+                              const float *amplitude, const float *freq, const float *damp,
+                              const float *phase)
+{
+    for (unsigned k = 0; k < nchanged; k++)
+    {
+        if (index[k] >= nLines())
+            throw std::out_of_range("No line " + std::to_string(index[k]) + " of "
+                                    + std::to_string(nLines()));
+    }
+
+    // line k of the change is subtracted as line 2k and added as line 2k + 1
+    std::vector<float> a(2 * nchanged), f(2 * nchanged), d(2 * nchanged), p(2 * nchanged);
+    for (unsigned k = 0; k < nchanged; k++)
+    {
+        const unsigned i = index[k];
+        a[2 * k] = -mAmplitude[i];
+        f[2 * k] = mFreq[i];
+        d[2 * k] = mDamp[i];
+        p[2 * k] = mPhase[i];
+
+        a[2 * k + 1] = mAmplitude[i] = amplitude[k];
+        f[2 * k + 1] = mFreq[i] = freq[k];
+        d[2 * k + 1] = mDamp[i] = damp[k];
+        p[2 * k + 1] = mPhase[i] = phase[k];
+    }
+
+    mChanged += nchanged;
+    if (2 * nchanged >= nLines() || mChanged >= mRebuildInterval)
+    {
+        rebuild();
+        return;
+    }
+
+    accumulate(2 * nchanged, a.data(), f.data(), d.data(), p.data());
+}
+
+void IncrementalSynth::update(unsigned index, float amplitude, float freq, float damp,
+                              float phase)
+{
+    update(1, &index, &amplitude, &freq, &damp, &phase);
+}
+
+void IncrementalSynth::rebuild()
+{
+    std::fill(mFid.begin(), mFid.end(), Complexd(0.0, 0.0));
+    accumulate(nLines(), mAmplitude.data(), mFreq.data(), mDamp.data(), mPhase.data());
+    mChanged = 0;
+}
+
+void IncrementalSynth::accumulate(unsigned nlines, const float *amplitude, const float *freq,
+                                  const float *damp, const float *phase)
+{
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    Instrument::count(Instrument::SAMPLES_GENERATED, mNpts);
+
+    DecayKernel kernel(nlines, mDwell, amplitude, freq, damp, phase, mDe, mMode,
+                       DataGenerator::DOUBLE_PRECISION);
+    kernel.accumulate<DataGenerator::SIMULTANEOUS>(mFid.data(), 0, mNpts, mThreads);
+}
+
+void IncrementalSynth::setRebuildInterval(unsigned nlines)
+{
+    mRebuildInterval = nlines;
+}
+
+unsigned IncrementalSynth::rebuildInterval() const
+{
+    return mRebuildInterval;
+}
+
+const Complexd *IncrementalSynth::fid() const
+{
+    return mFid.data();
+}
+
+long IncrementalSynth::size() const
+{
+    return mNpts;
+}
+
+void IncrementalSynth::copyFid(Complexf *fid) const
+{
+    std::transform(mFid.begin(), mFid.end(), fid, [](const Complexd& z)
+    {
+        return Complexf(z);
+    });
+}
+
+unsigned IncrementalSynth::nLines() const
+{
+    return unsigned(mAmplitude.size());
+}
+
+const float *IncrementalSynth::amplitude() const
+{
+    return mAmplitude.data();
+}
+
+const float *IncrementalSynth::freq() const
+{
+    return mFreq.data();
+}
+
+const float *IncrementalSynth::damp() const
+{
+    return mDamp.data();
+}
+
+const float *IncrementalSynth::phase() const
+{
+    return mPhase.data();
+}
@@ -0,0 +1,227 @@
+//
+//  Instrument.cpp
+//  Ranger
+//
+
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Instrument.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+const std::chrono::steady_clock::time_point Instrument::sStart
+    = std::chrono::steady_clock::now();
+std::atomic<uint64_t> Instrument::sCounters[Instrument::NCOUNTERS];
+std::atomic<uint64_t> Instrument::sCalls[Instrument::NSTAGES];
+std::atomic<uint64_t> Instrument::sNanoseconds[Instrument::NSTAGES];
+std::atomic<bool> Instrument::sTracing(false);
+
+static const char *const STAGE_NAMES[Instrument::NSTAGES] =
+{
+    "parse", "synthesis", "noise", "format", "write"
+};
+
+static const char *const COUNTER_NAMES[Instrument::NCOUNTERS] =
+{
+    "bytes_written", "syscalls", "samples_generated", "noise_deviates", "lines_processed"
+};
+
+struct TraceEvent
+{
+    uint64_t start;     // ns
+    uint64_t end;
+    Instrument::Stage stage;
+};
+
+// the events of one thread, numbered from 1 in the order threads first record
+struct ThreadTrace
+{
+    unsigned tid;
+    std::vector<TraceEvent> events;
+};
+
+/* Every thread's buffer is kept until the program ends so that the events
+   of worker threads outlive them.  The lock is taken only when a thread
+   records its first event and when the trace is written or reset. */
+static std::mutex traceMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> traceThreads;
+static thread_local ThreadTrace *threadTrace = nullptr;
+
+// where setupFromEnvironment() sends the summary and trace at exit
+static std::string summaryFName;
+static std::string traceFName;
+
+void Instrument::record(Stage stage, uint64_t start, uint64_t end)
+{
+    sCalls[stage].fetch_add(1, std::memory_order_relaxed);
+    sNanoseconds[stage].fetch_add(end - start, std::memory_order_relaxed);
+
+    if (!tracing())
+        return;
+
+    if (threadTrace == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceThreads.emplace_back(new ThreadTrace{unsigned(traceThreads.size() + 1), {}});
+        threadTrace = traceThreads.back().get();
+    }
+    threadTrace->events.push_back({start, end, stage});
+}
+
+uint64_t Instrument::counter(Counter counter)
+{
+    return sCounters[counter].load(std::memory_order_relaxed);
+}
+
+uint64_t Instrument::calls(Stage stage)
+{
+    return sCalls[stage].load(std::memory_order_relaxed);
+}
+
+double Instrument::seconds(Stage stage)
+{
+    return sNanoseconds[stage].load(std::memory_order_relaxed) * 1.0e-9;
+}
+
+const char *Instrument::name(Stage stage)
+{
+    return STAGE_NAMES[stage];
+}
+
+const char *Instrument::name(Counter counter)
+{
+    return COUNTER_NAMES[counter];
+}
+
+// not while other threads are recording
+void Instrument::reset()
+{
+    for (std::atomic<uint64_t>& counter : sCounters)
+        counter.store(0, std::memory_order_relaxed);
+    for (unsigned stage = 0; stage < NSTAGES; stage++)
+    {
+        sCalls[stage].store(0, std::memory_order_relaxed);
+        sNanoseconds[stage].store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    for (std::unique_ptr<ThreadTrace>& thread : traceThreads)
+        thread->events.clear();
+}
+
+void Instrument::startTrace()
+{
+    sTracing.store(true, std::memory_order_relaxed);
+}
+
+void Instrument::writeSummary(std::ostream& os)
+{
+    char text[128];
+    std::snprintf(text, sizeof(text), "{\n  \"wall_seconds\": %.9g,\n  \"stages\": {\n",
+                  now() * 1.0e-9);
+    os << text;
+    for (unsigned stage = 0; stage < NSTAGES; stage++)
+    {
+        std::snprintf(text, sizeof(text), "    \"%s\": {\"calls\": %llu, \"seconds\": %.9g}%s\n",
+                      STAGE_NAMES[stage], (unsigned long long)calls(Stage(stage)),
+                      seconds(Stage(stage)), stage + 1 < NSTAGES ? "," : "");
+        os << text;
+    }
+    os << "  },\n  \"counters\": {\n";
+    for (unsigned i = 0; i < NCOUNTERS; i++)
+    {
+        std::snprintf(text, sizeof(text), "    \"%s\": %llu%s\n", COUNTER_NAMES[i],
+                      (unsigned long long)counter(Counter(i)), i + 1 < NCOUNTERS ? "," : "");
+        os << text;
+    }
+    os << "  }\n}\n";
+}
+
+// not while other threads are recording
+void Instrument::writeTrace(std::ostream& os)
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+
+    // complete ("X") events, times in microseconds
+    char text[160];
+    const char *separator = "\n";
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (const std::unique_ptr<ThreadTrace>& thread : traceThreads)
+    {
+        for (const TraceEvent& event : thread->events)
+        {
+            std::snprintf(text, sizeof(text),
+                          "%s{\"name\": \"%s\", \"cat\": \"nmrsim\", \"ph\": \"X\", "
+                          "\"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                          separator, STAGE_NAMES[event.stage], thread->tid,
+                          event.start * 1.0e-3, (event.end - event.start) * 1.0e-3);
+            os << text;
+            separator = ",\n";
+        }
+    }
+    os << "\n]}\n";
+}
+
+static void writeAtExit()
+{
+    if (summaryFName == "-")
+    {
+        Instrument::writeSummary(std::cerr);
+    }
+    else if (!summaryFName.empty())
+    {
+        std::ofstream os(summaryFName);
+        Instrument::writeSummary(os);
+        if (!os)
+            std::cerr << "Unable to write to file: " << summaryFName << std::endl;
+    }
+
+    if (!traceFName.empty())
+    {
+        std::ofstream os(traceFName);
+        Instrument::writeTrace(os);
+        if (!os)
+            std::cerr << "Unable to write to file: " << traceFName << std::endl;
+    }
+}
+
+void Instrument::setupFromEnvironment()
+{
+    const char *summary = std::getenv("NMRSIM_PROFILE");
+    const char *trace = std::getenv("NMRSIM_TRACE");
+    if (summary != nullptr)
+        summaryFName = summary;
+    if (trace != nullptr)
+    {
+        traceFName = trace;
+        startTrace();
+    }
+
+    static bool registered = false;
+    if (!registered && (!summaryFName.empty() || !traceFName.empty()))
+    {
+        std::atexit(writeAtExit);
+        registered = true;
+    }
+}
@@ -0,0 +1,139 @@
+//
+//  Instrument.h
+//  Ranger
+//
+
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+/* Timers and counters of a generation run, cheap enough to leave on.
+   Each stage of a run keeps the number of calls and the total time of its
+   ScopedTimer scopes, summed over threads, and each counter is a relaxed
+   atomic added to once per call rather than once per sample.  Events are
+   recorded for a Chrome trace only once startTrace() has been called, in a
+   buffer of each thread, so the threads of a run do not contend for them.
+
+   Set NMRSIM_PROFILE to a file name ("-" for standard error) to have the
+   JSON summary written there when the program exits, and NMRSIM_TRACE to
+   a file name to have the trace events written there; the trace opens in
+   chrome://tracing or Perfetto. */
+class Instrument
+{
+public:
+    enum Stage
+    {
+        PARSE,          // reading spec files (InputSpecs::read(), getInputSpecs())
+        SYNTHESIS,      // the make*Fid() functions and streamRanger() pieces
+        NOISE,          // adding noise
+        FORMAT,         // gnuplot text
+        WRITE,          // ProNmr, RANGER and gnuplot files
+        NSTAGES
+    };
+
+    enum Counter
+    {
+        BYTES_WRITTEN,      // to files, including those written through ProNmrMap
+        SYSCALLS,           // of the file writers; a stream write counts as one
+        SAMPLES_GENERATED,  // points synthesised
+        NOISE_DEVIATES,     // floats that noise was added to
+        LINES_PROCESSED,    // of line lists read
+        NCOUNTERS
+    };
+
+    // nanoseconds since the program started
+    static uint64_t now()
+    {
+        using namespace std::chrono;
+        return uint64_t(duration_cast<nanoseconds>(steady_clock::now() - sStart).count());
+    }
+
+    static void count(Counter counter, uint64_t n)
+    {
+        sCounters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static bool tracing()
+    {
+        return sTracing.load(std::memory_order_relaxed);
+    }
+
+    // adds the scope of a ScopedTimer from start to end (ns) to stage
+    static void record(Stage stage, uint64_t start, uint64_t end);
+
+    static uint64_t counter(Counter counter);
+    static uint64_t calls(Stage stage);
+    static double seconds(Stage stage);
+
+    // names used in the summary and trace
+    static const char *name(Stage stage);
+    static const char *name(Counter counter);
+
+    // zeroes the counters and stage times and drops any trace events
+    static void reset();
+
+    // records trace events from now on
+    static void startTrace();
+
+    /* The JSON summary: the wall time since the program started, the calls
+       and seconds of each stage and the counters. */
+    static void writeSummary(std::ostream& os);
+
+    // the trace events recorded so far in the Chrome trace event format
+    static void writeTrace(std::ostream& os);
+
+    /* Starts tracing if NMRSIM_TRACE is set and arranges for the summary
+       and trace to be written at exit as described above. */
+    static void setupFromEnvironment();
+
+private:
+    static const std::chrono::steady_clock::time_point sStart;
+    static std::atomic<uint64_t> sCounters[NCOUNTERS];
+    static std::atomic<uint64_t> sCalls[NSTAGES];
+    static std::atomic<uint64_t> sNanoseconds[NSTAGES];
+    static std::atomic<bool> sTracing;
+};
+
+// times its own scope as one call of a stage
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Instrument::Stage stage)
+        : mStage(stage), mStart(Instrument::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        Instrument::record(mStage, mStart, Instrument::now());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Instrument::Stage mStage;
+    uint64_t mStart;
+};
+
+#endif // INSTRUMENT_H
@@ -0,0 +1,165 @@
+//
+//  JacobianSynth.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JacobianSynth.h"
+#include "DecayKernel.h"
+#include "Instrument.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+/* A line that has decayed to this fraction of its size at time 0 by the
+   start of a segment has its FID and derivatives set to zero for the rest
+   of the FID, far below the rounding error of their largest values.
+   Stepping it on would soon produce denormals, which are very slow. */
+static const double MIN_MAGNITUDE = 1.0e-30;
+
+JacobianSynth::JacobianSynth(unsigned nlines, float dwell, const float *amplitude,
+                             const float *freq, const float *damp, const float *phase,
+                             float de)
+    : mDwell(dwell), mDe(de), mAmplitude(amplitude, amplitude + nlines),
+      mOmega(nlines), mDamp(damp, damp + nlines), mPhase(nlines)
+{
+    for (unsigned i = 0; i < nlines; i++)
+    {
+        mOmega[i] = 2.0 * M_PI * freq[i];
+        mPhase[i] = phase[i] * M_PI / 180.0;
+    }
+}
+
+void JacobianSynth::evaluate(long npts, Complexd *fid, double *jacobian, long ld,
+                             unsigned nthreads) const
+{
+    if (npts < 0)
+        throw std::invalid_argument("Negative FID size: " + std::to_string(npts));
+    if (ld < 2 * npts)
+        throw std::invalid_argument("Jacobian leading dimension " + std::to_string(ld)
+                                    + " is less than " + std::to_string(2 * npts) + " rows");
+
+    ScopedTimer timer(Instrument::SYNTHESIS);
+    Instrument::count(Instrument::SAMPLES_GENERATED, npts);
+
+    // the first chunk is summed in fid itself and the others added to it in order
+    const unsigned nchunks = (nLines() + CHUNK_LINES - 1) / CHUNK_LINES;
+    std::vector<std::vector<Complexd>> sums(nchunks > 1 ? nchunks - 1 : 0);
+    std::fill(fid, fid + npts, Complexd(0.0, 0.0));
+
+    parallelFor(nthreads, nchunks, [&](unsigned chunk)
+    {
+        Complexd *sum = fid;
+        if (chunk > 0)
+        {
+            sums[chunk - 1].assign(npts, Complexd(0.0, 0.0));
+            sum = sums[chunk - 1].data();
+        }
+        const unsigned first = chunk * CHUNK_LINES;
+        evaluateLines(first, std::min(unsigned(CHUNK_LINES), nLines() - first), npts, sum,
+                      jacobian, ld);
+    });
+
+    for (const std::vector<Complexd>& sum : sums)
+    {
+        for (long n = 0; n < npts; n++)
+            fid[n] += sum[n];
+    }
+}
+
+void JacobianSynth::evaluate(long npts, Eigen::VectorXcd& fid, Eigen::MatrixXd& jacobian,
+                             unsigned nthreads) const
+{
+    if (npts < 0)
+        throw std::invalid_argument("Negative FID size: " + std::to_string(npts));
+    fid.resize(npts);
+    jacobian.resize(2 * npts, long(nLines()) * NPARAMETERS);
+    evaluate(npts, fid.data(), jacobian.data(), 2 * npts, nthreads);
+}
+
+/* The complex products are written out in real arithmetic, as
+   std::complex multiplication is a library call that handles NaNs and
+   infinities unless compiled with -ffast-math. */
+void JacobianSynth::evaluateLines(unsigned first, unsigned nlines, long npts, Complexd *fid,
+                                  double *jacobian, long ld) const
+{
+    const double DEGREE = M_PI / 180.0;
+
+    for (unsigned line = first; line < first + nlines; line++)
+    {
+        const double amplitude = mAmplitude[line];
+        const double omega = mOmega[line];
+        const double damp = mDamp[line];
+        const double stepDecay = std::exp(damp * mDwell);
+        const double stepRe = stepDecay * std::cos(omega * mDwell);
+        const double stepIm = stepDecay * std::sin(omega * mDwell);
+
+        double *dAmplitude = jacobian + column(line, AMPLITUDE) * ld;
+        double *dFreq = jacobian + column(line, FREQ) * ld;
+        double *dDamp = jacobian + column(line, DAMP) * ld;
+        double *dPhase = jacobian + column(line, PHASE) * ld;
+
+        for (long start = 0; start < npts; start += DecayKernel::SEGMENT_POINTS)
+        {
+            const long end = std::min(npts, start + long(DecayKernel::SEGMENT_POINTS));
+
+            // the unit phasor u at the start of the segment, from its closed form
+            const double t0 = mDe + start * mDwell;
+            const double magnitude = std::exp(damp * t0);
+            if (magnitude < MIN_MAGNITUDE && damp <= 0.0)
+            {
+                std::fill(dAmplitude + 2 * start, dAmplitude + 2 * npts, 0.0);
+                std::fill(dFreq + 2 * start, dFreq + 2 * npts, 0.0);
+                std::fill(dDamp + 2 * start, dDamp + 2 * npts, 0.0);
+                std::fill(dPhase + 2 * start, dPhase + 2 * npts, 0.0);
+                break;
+            }
+            const double angle = omega * t0 + mPhase[line];
+            double uRe = magnitude * std::cos(angle);
+            double uIm = magnitude * std::sin(angle);
+
+            for (long n = start; n < end; n++)
+            {
+                const double t = mDe + n * mDwell;
+                const double zRe = amplitude * uRe;
+                const double zIm = amplitude * uIm;
+
+                fid[n] += Complexd(zRe, zIm);
+                dAmplitude[2 * n] = uRe;
+                dAmplitude[2 * n + 1] = uIm;
+                dFreq[2 * n] = -2.0 * M_PI * t * zIm;
+                dFreq[2 * n + 1] = 2.0 * M_PI * t * zRe;
+                dDamp[2 * n] = t * zRe;
+                dDamp[2 * n + 1] = t * zIm;
+                dPhase[2 * n] = -DEGREE * zIm;
+                dPhase[2 * n + 1] = DEGREE * zRe;
+
+                const double re = uRe * stepRe - uIm * stepIm;
+                uIm = uRe * stepIm + uIm * stepRe;
+                uRe = re;
+            }
+        }
+    }
+}
+
+unsigned JacobianSynth::nLines() const
+{
+    return unsigned(mAmplitude.size());
+}
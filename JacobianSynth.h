@@ -0,0 +1,113 @@
+//
+//  JacobianSynth.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef JACOBIANSYNTH_H
+#define JACOBIANSYNTH_H
+
+#include "DataGenerator.h"
+
+#include <Eigen/Dense>
+
+#include <vector>
+
+/* Makes the FID of a line list and its Jacobian, the partial derivatives
+   with respect to the amplitude, frequency, damping and phase of every
+   line, for fitters that would otherwise take them by finite differences
+   from 4 * nlines + 1 calls of DataGenerator::makeSimFid().
+
+   Sample n of line l, at t = de + n * dwell, is z = amplitude * u with
+   u = exp(damp * t) * exp(i * (2 * pi * freq * t + phase * pi / 180)), so
+       dz / d amplitude  = u
+       dz / d freq       = i * 2 * pi * t * z      (per Hz)
+       dz / d damp       = t * z                   (per 1 / s)
+       dz / d phase      = i * pi / 180 * z        (per degree)
+   The four are written as z is made, in one pass over each line's phasor,
+   which is stepped in double and restarted from its closed form every
+   DecayKernel::SEGMENT_POINTS samples as in DecayKernel.
+
+   The Jacobian is a real, column-major matrix of 2 * npts rows, the real
+   and imaginary parts of sample n in rows 2n and 2n + 1 as in the
+   memory of the FID, and 4 * nlines columns, column(l, p) holding the
+   derivative with respect to parameter p of line l.  Its rows thus match
+   a residual vector mapped onto the FID, as Eigen's solvers expect.
+
+   Lines are taken CHUNK_LINES at a time, one chunk per task, and the FIDs
+   of the chunks are added in chunk order, so the result is the same for
+   any thread count.  Writing the Jacobian dominates the run time: 8 doubles
+   per sample per line. */
+class JacobianSynth
+{
+public:
+    enum
+    {
+        CHUNK_LINES = 64
+    };
+
+    // the columns of each line, in order
+    enum Parameter
+    {
+        AMPLITUDE, FREQ, DAMP, PHASE, NPARAMETERS
+    };
+
+    /**
+        nlines       -- number of lines in the arrays
+        dwell        -- dwell period (s)
+        amplitude    -- amplitude (peak areas) of each line (== value at time == 0)
+        freq         -- frequency (rotating frame) of each line (Hz)
+        damp         -- damping factor of each line (1 / s)
+        phase        -- phase of each line at time == 0 (degrees)
+        de           -- pre-acq delay (s)
+    */
+    JacobianSynth(unsigned nlines, float dwell, const float *amplitude, const float *freq,
+                  const float *damp, const float *phase, float de);
+
+    /* Sets the npts points of fid to the FID and the columns of jacobian,
+       whose column k starts at jacobian[k * ld], to the derivatives.  ld
+       must be at least 2 * npts.  Throws std::invalid_argument if npts is
+       negative or ld too small. */
+    void evaluate(long npts, Complexd *fid, double *jacobian, long ld,
+                  unsigned nthreads = 1) const;
+
+    // the same into an Eigen vector and matrix, which are resized to fit
+    void evaluate(long npts, Eigen::VectorXcd& fid, Eigen::MatrixXd& jacobian,
+                  unsigned nthreads = 1) const;
+
+    // the column of parameter p of line
+    static long column(unsigned line, Parameter p)
+    {
+        return long(line) * NPARAMETERS + p;
+    }
+
+    unsigned nLines() const;
+
+private:
+    // adds lines first .. first + nlines - 1 to fid and writes their columns
+    void evaluateLines(unsigned first, unsigned nlines, long npts, Complexd *fid,
+                       double *jacobian, long ld) const;
+
+    double mDwell;
+    double mDe;
+    std::vector<double> mAmplitude;
+    std::vector<double> mOmega;     // 2 * pi * freq (rad / s)
+    std::vector<double> mDamp;
+    std::vector<double> mPhase;     // rad
+};
+
+#endif // JACOBIANSYNTH_H
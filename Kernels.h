@@ -0,0 +1,60 @@
+//
+//  Kernels.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "DecayKernel.h"
+#include "Philox.h"
+#include "SampleFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/* The hot loops of the program, compiled once for each instruction set of
+   CpuDispatch: baseline:: in KernelsBaseline.cpp, avx2:: in KernelsAvx2.cpp
+   and avx512:: in KernelsAvx512.cpp.  Nothing in their arguments depends
+   on the instruction set, so DecayKernel, GaussianNoise and RangerWriter
+   call the ones of CpuDispatch::active() through a switch.
+
+   sumDecays()          DecayKernel::accumulateSamples() of lines, which
+                        must have been laid out for the same instruction set
+   gaussianDeviates()   deviates first .. first + count - 1 of the
+                        GaussianNoise stream of philox, spectrum and block
+   encodeSamples()      ::encodeSamples() in whole vectors */
+#define DECLARE_KERNELS(ISA) \
+    namespace ISA \
+    { \
+        template <DataGenerator::Acquisition ACQUISITION, typename Sample> \
+        void sumDecays(const DecayKernel::Lines& lines, Sample *out, long first, long count, \
+                       unsigned nthreads); \
+        void gaussianDeviates(const Philox& philox, uint32_t spectrum, uint32_t block, \
+                              uint64_t first, long count, float *normals); \
+        template <typename Storage, typename Real> \
+        void encodeSamples(unsigned char *dest, const Real *src, size_t count, double scale); \
+    }
+
+DECLARE_KERNELS(baseline)
+DECLARE_KERNELS(avx2)
+DECLARE_KERNELS(avx512)
+
+#undef DECLARE_KERNELS
+
+#endif // KERNELS_H
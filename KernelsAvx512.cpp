@@ -0,0 +1,52 @@
+//
+//  KernelsAvx512.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Kernels.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* The kernels of Kernels.h for AVX-512 (F, DQ, BW and VL) as well as AVX2,
+   FMA and F16C, chosen by CpuDispatch on CPUs that have them.  Off x86
+   they are compiled as generic vectors but never chosen. */
+#define VEC_LANES 16
+#define VEC_ISA avx512
+
+/* Everything from here on may use AVX-512, but the headers above, and with
+   them the standard library templates, stay compiled for the baseline. */
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma,f16c")
+#endif
+
+#include "DecayKernelSums.h"
+#include "GaussianNoiseDeviates.h"
+#include "SampleFormatVectors.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,37 @@
+//
+//  KernelsBaseline.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Kernels.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/* The kernels of Kernels.h for the instruction set the program is compiled
+   for, which should be the x86-64 baseline (SSE2): they are the ones every
+   node can run.  Off x86 they are the only ones used. */
+#define VEC_LANES 4
+#define VEC_ISA baseline
+
+#include "DecayKernelSums.h"
+#include "GaussianNoiseDeviates.h"
+#include "SampleFormatVectors.h"
@@ -0,0 +1,113 @@
+//
+//  LittleEndian.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LITTLEENDIAN_H
+#define LITTLEENDIAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* Fields of the binary file formats, which are little-endian whatever the
+   host. */
+
+inline bool littleEndianHost()
+{
+    const uint32_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+inline void put16(unsigned char *p, uint16_t value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+inline void put32(unsigned char *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+inline void put64(unsigned char *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+inline void putDouble(unsigned char *p, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, 8);
+    put64(p, bits);
+}
+
+inline uint16_t get16(const unsigned char *p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+inline uint32_t get32(const unsigned char *p)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= uint32_t(p[i]) << (8 * i);
+    return value;
+}
+
+inline uint64_t get64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= uint64_t(p[i]) << (8 * i);
+    return value;
+}
+
+inline double getDouble(const unsigned char *p)
+{
+    uint64_t bits = get64(p);
+    double value;
+    std::memcpy(&value, &bits, 8);
+    return value;
+}
+
+// copies count floats between host order and little-endian
+inline void copyFloats(void *dest, const void *src, size_t count)
+{
+    if (littleEndianHost())
+    {
+        std::memcpy(dest, src, count * sizeof(float));
+        return;
+    }
+
+    const unsigned char *s = static_cast<const unsigned char *>(src);
+    unsigned char *d = static_cast<unsigned char *>(dest);
+    for (size_t i = 0; i < count; i++, s += 4, d += 4)
+    {
+        d[0] = s[3];
+        d[1] = s[2];
+        d[2] = s[1];
+        d[3] = s[0];
+    }
+}
+
+#endif // LITTLEENDIAN_H
@@ -0,0 +1,251 @@
+//
+//  NufftSynth.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "NufftSynth.h"
+
+#include <unsupported/Eigen/FFT>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+/* Costs in seconds, fitted to single threaded runs of an AVX-512 build
+   with 256 to 262144 points and 100 to 200000 lines.  The direct figures
+   are for DecayKernel in PHASOR mode. */
+static const double DIRECT_COST = 4.8e-10;      // per sample per line
+static const double DIRECT_LINE_COST = 1.7e-7;  // per line
+static const double LINE_COST = 1.5e-7;         // per line
+static const double SPREAD_COST = 1.2e-8;       // per kernel point per line per term
+static const double FFT_COST = 1.0e-8;          // per M log2(M) of a transform
+static const double TERM_COST = 3.0e-8;         // per sample per Taylor term
+
+/* Below this many samples * lines the direct sum was faster in every run,
+   even for lines that all share one damping value. */
+const double NufftSynth::CROSSOVER_WORK = 4.0e6;
+
+// largest |delta * t| allowed within a cluster
+static const double CLUSTER_RANGE = 1.0;
+
+static const unsigned MAX_TERMS = 30;
+
+// smallest even size >= n with no prime factors other than 2, 3 and 5
+static long fftSize(long n)
+{
+    for (long m = std::max(n + (n & 1), 2L); ; m += 2)
+    {
+        long r = m;
+        for (long p : {2, 3, 5})
+            while (r % p == 0)
+                r /= p;
+        if (r == 1)
+            return m;
+    }
+}
+
+NufftSynth::NufftSynth(unsigned nlines, float dwell, const float *amplitude,
+                       const float *freq, const float *damp, const float *phase,
+                       float de, long npts, double tolerance)
+    : mNPts(npts), mDwell(dwell), mTolerance(tolerance),
+      mWeight(nlines), mTheta(nlines), mDamp(nlines)
+{
+    /* Gaussian kernel half width for a twofold oversampled grid; the error
+       falls as exp(-(2 * pi / 3) * spread) (Greengard and Lee), with one
+       more point for the error of the Taylor terms and the sum */
+    mSpread = int(std::ceil(-std::log(tolerance) / (2.0 * M_PI / 3.0))) + 1;
+    mSpread = std::max(2, std::min(mSpread, 16));
+
+    for (unsigned i = 0; i < nlines; i++)
+    {
+        // convert input parameters to radians
+        double omega = 2.0 * M_PI * freq[i];
+
+        mWeight[i] = double(amplitude[i])
+            * std::exp(std::complex<double>(double(damp[i]) * de,
+                                            omega * de + phase[i] * M_PI / 180.0));
+        mTheta[i] = std::remainder(omega * dwell, 2.0 * M_PI);
+        mDamp[i] = damp[i];
+    }
+
+    makeClusters(nlines, damp);
+}
+
+void NufftSynth::makeClusters(unsigned nlines, const float *damp)
+{
+    // least damped first
+    std::vector<unsigned> order(nlines);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [damp](unsigned a, unsigned b) { return damp[a] > damp[b]; });
+
+    for (unsigned i = 0; i < nlines; )
+    {
+        Cluster cluster;
+
+        // the cluster lasts until its least damped line has died away
+        const double dmax = damp[order[i]];
+        double span = (mNPts - 1) * mDwell;
+        if (dmax < 0.0)
+            span = std::min(span, std::log(1.0 / mTolerance) / -dmax);
+        cluster.npts = std::min(mNPts, long(span / mDwell) + 1);
+        span = (cluster.npts - 1) * mDwell;
+
+        const double width = span > 0.0 ? 2.0 * CLUSTER_RANGE / span : HUGE_VAL;
+        double dmin = dmax;
+        while (i < nlines && damp[order[i]] >= dmax - width)
+        {
+            dmin = damp[order[i]];
+            cluster.lines.push_back(order[i++]);
+        }
+        cluster.damp = 0.5 * (dmax + dmin);
+
+        // Taylor terms needed for exp(delta * t), |delta * t| <= range
+        const double range = 0.5 * (dmax - dmin) * span;
+        double remainder = std::exp(range);
+        cluster.nterms = 1;
+        while (cluster.nterms < MAX_TERMS)
+        {
+            remainder *= range / cluster.nterms;
+            if (remainder <= mTolerance)
+                break;
+            cluster.nterms++;
+        }
+
+        cluster.nfft = fftSize(cluster.npts);
+        mClusters.push_back(cluster);
+    }
+}
+
+unsigned NufftSynth::nTransforms() const
+{
+    unsigned n = 0;
+    for (const Cluster& cluster : mClusters)
+        n += cluster.nterms;
+    return n;
+}
+
+double NufftSynth::estimatedCost() const
+{
+    double cost = 0.0;
+    for (const Cluster& cluster : mClusters)
+    {
+        const double ngrid = 2.0 * cluster.nfft;
+        cost += cluster.lines.size() * (LINE_COST + 2.0 * mSpread * cluster.nterms * SPREAD_COST);
+        cost += cluster.nterms * (ngrid * std::log2(ngrid) * FFT_COST
+                                  + cluster.npts * TERM_COST);
+    }
+    return cost;
+}
+
+double NufftSynth::directCost(unsigned nlines, long npts)
+{
+    return (DIRECT_COST * npts + DIRECT_LINE_COST) * nlines;
+}
+
+/* terms[p * nfft + n] = sum over the cluster's lines of
+   weight * (delta * span)^p / p! * exp(i * n * theta) for n < nfft */
+void NufftSynth::transform(const Cluster& cluster, std::vector<std::complex<double>>& terms) const
+{
+    const long nfft = cluster.nfft;
+    const long ngrid = 2 * nfft;
+    const double gridStep = 2.0 * M_PI / ngrid;
+    const double tau = M_PI * mSpread / (3.0 * nfft * nfft);
+    const double span = (cluster.npts - 1) * mDwell;
+    const unsigned nterms = cluster.nterms;
+
+    std::vector<std::complex<double>> grid(size_t(nterms) * ngrid, 0.0);
+    std::vector<double> kernel(2 * mSpread);
+    std::vector<std::complex<double>> weight(nterms);
+
+    // spread every line onto the grid
+    for (unsigned line : cluster.lines)
+    {
+        /* transform index k = n - nfft / 2 runs over [-nfft / 2, nfft / 2)
+           and the line sits at -theta so the forward FFT gives
+           exp(+i * k * theta) */
+        const double theta = mTheta[line];
+        double x = std::fmod(-theta, 2.0 * M_PI);
+        if (x < 0.0)
+            x += 2.0 * M_PI;
+
+        const long m0 = long(x / gridStep);
+        for (int q = 0; q < 2 * mSpread; q++)
+        {
+            double dist = x - (m0 - mSpread + 1 + q) * gridStep;
+            kernel[q] = std::exp(-dist * dist / (4.0 * tau));
+        }
+
+        const double delta = (mDamp[line] - cluster.damp) * span;
+        weight[0] = mWeight[line] * std::polar(1.0, 0.5 * nfft * theta);
+        for (unsigned p = 1; p < nterms; p++)
+            weight[p] = weight[p - 1] * delta / double(p);
+
+        for (unsigned p = 0; p < nterms; p++)
+        {
+            std::complex<double> *row = &grid[size_t(p) * ngrid];
+            for (int q = 0; q < 2 * mSpread; q++)
+            {
+                long m = (m0 - mSpread + 1 + q) % ngrid;
+                if (m < 0)
+                    m += ngrid;
+                row[m] += weight[p] * kernel[q];
+            }
+        }
+    }
+
+    // transform and divide out the kernel
+    Eigen::FFT<double> fft;
+    std::vector<std::complex<double>> in(ngrid), out(ngrid);
+    terms.assign(size_t(nterms) * nfft, 0.0);
+    for (unsigned p = 0; p < nterms; p++)
+    {
+        std::copy(grid.begin() + size_t(p) * ngrid, grid.begin() + size_t(p + 1) * ngrid, in.begin());
+        fft.fwd(out, in);
+
+        for (long n = 0; n < nfft; n++)
+        {
+            long k = n - nfft / 2;
+            double deconvolve = std::sqrt(M_PI / tau) * std::exp(k * k * tau) / ngrid;
+            terms[size_t(p) * nfft + n] = out[(k + ngrid) % ngrid] * deconvolve;
+        }
+    }
+}
+
+void NufftSynth::accumulate(Complexf *fid) const
+{
+    std::vector<std::complex<double>> terms;
+
+    for (const Cluster& cluster : mClusters)
+    {
+        transform(cluster, terms);
+
+        const double span = (cluster.npts - 1) * mDwell;
+        for (long n = 0; n < cluster.npts; n++)
+        {
+            const double u = span > 0.0 ? n * mDwell / span : 0.0;
+
+            // Horner's rule over the Taylor terms
+            std::complex<double> sum = terms[size_t(cluster.nterms - 1) * cluster.nfft + n];
+            for (int p = int(cluster.nterms) - 2; p >= 0; p--)
+                sum = sum * u + terms[size_t(p) * cluster.nfft + n];
+
+            fid[n] += Complexf(sum * std::exp(cluster.damp * n * mDwell));
+        }
+    }
+}
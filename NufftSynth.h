@@ -0,0 +1,107 @@
+//
+//  NufftSynth.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NUFFTSYNTH_H
+#define NUFFTSYNTH_H
+
+#include "DataGenerator.h"
+
+#include <complex>
+#include <vector>
+
+/* Builds a complex FID from a large line list with non-uniform FFTs instead
+   of summing every line at every sample.
+
+   Without damping the FID is s(n) = sum c_l exp(i * n * theta_l), a type 1
+   non-uniform FFT: each line is spread onto an oversampled frequency grid
+   with a Gaussian kernel (Greengard and Lee, SIAM Review 46, 2004), the
+   grid is transformed with one FFT and the kernel is divided out again.
+
+   Damping is handled by sorting the lines into clusters of similar damping.
+   Within a cluster exp(damp * t) = exp(dmean * t) * exp(delta * t) and the
+   second factor is expanded as a short Taylor series in t, each term of
+   which is one more transform.  A cluster only extends over the time its
+   least damped line needs to fall below the tolerance, which keeps both the
+   transforms and the Taylor series short for broad lines.
+
+   The cost therefore grows roughly as L + N log N per transform instead of
+   L * N.  Line lists with one or a few damping values need one or a few
+   transforms; lists with widely scattered damping need many, and
+   estimatedCost() says when the direct DecayKernel sum is still cheaper. */
+class NufftSynth
+{
+public:
+    /**
+        nlines       -- number of lines in the arrays
+        dwell        -- dwell period (s)
+        amplitude    -- amplitude (peak areas) of each line (== value at time == 0)
+        freq         -- frequency (rotating frame) of each line (Hz)
+        damp         -- damping factor of each line (1 / s)
+        phase        -- phase of each line at time == 0 (degrees)
+        de           -- pre-acq delay (s)
+        npts         -- number of complex points in the FID
+        tolerance    -- largest error allowed, relative to the amplitude of
+                        each line (1e-6 suits float output); the errors of
+                        the lines add, up to tolerance times the sum of the
+                        amplitudes
+    */
+    NufftSynth(unsigned nlines, float dwell, const float *amplitude, const float *freq,
+               const float *damp, const float *phase, float de, long npts,
+               double tolerance = 1.0e-6);
+
+    // adds the sum of all lines to fid[0] .. fid[npts - 1]
+    void accumulate(Complexf *fid) const;
+
+    // estimated run time (s) of accumulate()
+    double estimatedCost() const;
+
+    // estimated single threaded run time (s) of DecayKernel::accumulate()
+    static double directCost(unsigned nlines, long npts);
+
+    // samples * lines below which the direct sum is always faster
+    static const double CROSSOVER_WORK;
+
+    // number of transforms accumulate() will do
+    unsigned nTransforms() const;
+
+private:
+    struct Cluster
+    {
+        std::vector<unsigned> lines;
+        double damp;        // mean damping (1 / s)
+        long npts;          // samples the cluster contributes to
+        long nfft;          // size of the (not oversampled) transform
+        unsigned nterms;    // terms in the Taylor series
+    };
+
+    void makeClusters(unsigned nlines, const float *damp);
+    void transform(const Cluster& cluster, std::vector<std::complex<double>>& terms) const;
+
+    long mNPts;
+    double mDwell;
+    double mTolerance;
+    int mSpread;                                // kernel half width in grid points
+    std::vector<std::complex<double>> mWeight;  // amplitude and phase at sample 0
+    std::vector<double> mTheta;                 // evolution per dwell (rad)
+    std::vector<double> mDamp;
+    std::vector<Cluster> mClusters;
+};
+
+#endif // NUFFTSYNTH_H
@@ -0,0 +1,79 @@
+//
+//  Parallel.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+unsigned hardwareThreads()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void parallelFor(unsigned nthreads, unsigned ntasks, const std::function<void(unsigned)>& task)
+{
+    nthreads = std::min(nthreads, ntasks);
+
+    if (nthreads <= 1)
+    {
+        for (unsigned i = 0; i < ntasks; i++)
+            task(i);
+        return;
+    }
+
+    std::atomic<unsigned> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]()
+    {
+        for (unsigned i = next++; i < ntasks; i = next++)
+        {
+            try
+            {
+                task(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                next = ntasks;
+            }
+        }
+    };
+
+    // the calling thread is one of the workers
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < nthreads; i++)
+        threads.emplace_back(worker);
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
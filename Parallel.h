@@ -0,0 +1,93 @@
+//
+//  Parallel.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// number of hardware threads, at least 1
+unsigned hardwareThreads();
+
+/* Runs task(0) .. task(ntasks - 1) on up to nthreads threads and returns
+   when all have finished.  Tasks are handed out in order to whichever
+   thread is free so they should not depend on each other.  If any task
+   throws, the first exception is rethrown here once all threads have
+   stopped. */
+void parallelFor(unsigned nthreads, unsigned ntasks, const std::function<void(unsigned)>& task);
+
+/* A queue between threads that holds at most capacity items.  push() waits
+   while the queue is full and pop() while it is empty.  After close() both
+   return false instead of waiting, although items already queued can
+   still be popped, so a consumer stops once the producers are done and a
+   producer stops if the consumer gives up. */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mCapacity(capacity), mClosed(false)
+    {
+    }
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotFull.wait(lock, [this]() { return mClosed || mItems.size() < mCapacity; });
+        if (mClosed)
+            return false;
+        mItems.push_back(std::move(item));
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotEmpty.wait(lock, [this]() { return mClosed || !mItems.empty(); });
+        if (mItems.empty())
+            return false;
+        item = std::move(mItems.front());
+        mItems.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+private:
+    size_t mCapacity;
+    bool mClosed;
+    std::deque<T> mItems;
+    std::mutex mMutex;
+    std::condition_variable mNotEmpty;
+    std::condition_variable mNotFull;
+};
+
+#endif // PARALLEL_H
@@ -0,0 +1,89 @@
+//
+//  Philox.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+/* The Philox4x32-10 counter based random number generator of Salmon et al.,
+   "Parallel random numbers: as easy as 1, 2, 3" (SC11).
+
+   There is no state: four 32 bit random words are a pure function of a 128
+   bit counter and a 64 bit key, so any draw can be made in any order, on
+   any thread, and reproduced on its own.  The noise generators use the
+   seed as the key and (sample, spectrum, block) as the counter. */
+class Philox
+{
+public:
+    struct Block
+    {
+        uint32_t word[4];
+    };
+
+    explicit Philox(uint64_t seed)
+        : mKey0(uint32_t(seed)), mKey1(uint32_t(seed >> 32))
+    {
+    }
+
+    // the four random words for the counter (sample, spectrum, block)
+    Block operator()(uint64_t sample, uint32_t spectrum, uint32_t block) const
+    {
+        uint32_t c0 = uint32_t(sample);
+        uint32_t c1 = uint32_t(sample >> 32);
+        uint32_t c2 = spectrum;
+        uint32_t c3 = block;
+        uint32_t k0 = mKey0;
+        uint32_t k1 = mKey1;
+
+        for (int round = 0; round < 10; round++)
+        {
+            uint64_t p0 = uint64_t(M0) * c0;
+            uint64_t p1 = uint64_t(M1) * c2;
+            uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c1 = uint32_t(p1);
+            c3 = uint32_t(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += W0;
+            k1 += W1;
+        }
+
+        return Block{{c0, c1, c2, c3}};
+    }
+
+    // uniform deviate in [0, 1) from the top 24 bits of a random word
+    static float uniform(uint32_t word)
+    {
+        return float(word >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    static const uint32_t M0 = 0xD2511F53;
+    static const uint32_t M1 = 0xCD9E8D57;
+    static const uint32_t W0 = 0x9E3779B9;
+    static const uint32_t W1 = 0xBB67AE85;
+
+    uint32_t mKey0;
+    uint32_t mKey1;
+};
+
+#endif // PHILOX_H
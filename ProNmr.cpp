@@ -20,14 +20,31 @@
  */
 #include "ProNmr.h"
 #include "DataGenerator.h"
+#include "Instrument.h"
+#include "nmrsim.h"
 
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
 
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// complex points of a new header, the size createData() has always made
+static const unsigned short DEFAULT_DWELLS = 1024;
+
+// every field is zeroed first, so the comments and padding are written as zeros
 ProNmr::ProNmr()
 {
+    memset(static_cast<void *>(this), 0, sizeof(ProNmr));
     init();
 }
 
@@ -39,10 +56,10 @@ void ProNmr::init()
     fileversion = 2;
     offsets[ACQU] = 0;
     offsets[DAT] = 2;
-    si = NDWELLS * 2;
-    td = NDWELLS * 2;
+    si = DEFAULT_DWELLS * 2;
+    td = DEFAULT_DWELLS * 2;
     nrecs = 1;
-    dstatus |= AQ_SIM | SHUFF;
+    dstatus = AQ_SIM | SHUFF;
     ns = 1;
     sf = 100.0e6;
     o1 = 0.0;
@@ -58,199 +75,157 @@ void ProNmr::init()
     o11= 0.0;
 }
 
-void ProNmr::writeParams(const std::string& name)
+#define POINTSPERSEC 32 /* Data points per sector */
+#define SECSIZE 128     /* Bytes per hypothetical sector */
+
+int ProNmr::blockSize(int size)
 {
-    try
-    {
-        std::ofstream os(name, std::ios::binary);
-        os.exceptions(std::ofstream::failbit);
-    }
-    catch (std::ios_base::failure& fail)
+    return size < POINTSPERSEC ? POINTSPERSEC : size;
+}
+
+/* The parameters as written (sizeof(ProNmr)) are a little longer than the
+   two sectors they were laid out for and the data have always followed
+   straight after them, so the data never start before the end of the
+   parameters. */
+long ProNmr::dataOffset(int size, int datoffset, int blocknum)
+{
+    long start = std::max(long(datoffset) * SECSIZE, long(sizeof(ProNmr)));
+    return start + long(blocknum - 1) * size * long(sizeof(float));
+}
+
+/* Writes all of iov[0] .. iov[niov - 1] to fd from offset on, normally
+   with a single pwritev() (one per IOV_MAX vectors).  Returns false on
+   failure with errno set. */
+static bool writeAll(int fd, struct iovec *iov, int niov, off_t offset)
+{
+    while (niov > 0)
     {
-        std::cerr << "Unable to open file: " << name
-                  << "\n" << fail.what() << std::endl;
-        throw;
+        ssize_t nwritten = pwritev(fd, iov, std::min(niov, IOV_MAX), offset);
+        Instrument::count(Instrument::SYSCALLS, 1);
+        if (nwritten > 0)
+            Instrument::count(Instrument::BYTES_WRITTEN, uint64_t(nwritten));
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+        {
+            if (nwritten == 0)
+                errno = EIO;
+            return false;
+        }
+
+        // short write: skip what went out and carry on
+        offset += nwritten;
+        size_t done = size_t(nwritten);
+        while (niov > 0 && done >= iov->iov_len)
+        {
+            done -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (niov > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+            iov->iov_len -= done;
+        }
     }
+    return true;
+}
 
-    /* Put the new AQ parameters */
-    try
+/* Appends the vectors of nspec spectra of size floats from data, each
+   followed by the zeros of pad up to a whole block of blockSize(size)
+   floats, so nothing past the caller's size * nspec floats is read. */
+static void addBlocks(std::vector<struct iovec>& iov, const float *data, int size, int nspec,
+                      std::vector<float>& pad)
+{
+    const int block = ProNmr::blockSize(size);
+    if (block == size)
     {
-        os.write(*this, sizeof(ProNmr));
+        iov.push_back({const_cast<float *>(data), size_t(size) * nspec * sizeof(float)});
+        return;
     }
 
-    catch (std::ios_base::failure &fail)
+    pad.assign(size_t(block - size), 0.0f);
+    for (int i = 0; i < nspec; i++)
     {
-        std::cerr << "Unable to write to file: " << name
-                  << "\n" << fail.what() << std::endl;
-        throw;
+        iov.push_back({const_cast<float *>(data) + size_t(i) * size, size * sizeof(float)});
+        iov.push_back({pad.data(), pad.size() * sizeof(float)});
     }
 }
 
-int ProNmr::writeData(float* data, char* name, int size, int datoffset, int blocknum, int nspec)
+void ProNmr::writeParams(const std::string& name)
 {
+    writeFile(name, 0, 0, 0);
+}
 
-#define POINTSPERSEC 32 /* Data points per sector */
-#define SECSIZE 128     /* Bytes per hypothetical sector */
-
-    unsigned pointstowrite, pointswritten, index,
-        npoints, filepos, fileincr;
-    FILE *f1 = fopen(name, "a");
-
-    if (f1 == NULL) /* Open file for binary reading */
+int ProNmr::writeData(const float* data, char* name, int size, int datoffset, int blocknum, int nspec)
+{
+    /* The file is thought of as containing blocks of size points
+       following the header, at least POINTSPERSEC of them, one for each
+       spectrum of a serial file.  The nspec blocks from blocknum on are
+       contiguous and go out in one write. */
+    ScopedTimer timer(Instrument::WRITE);
+    Instrument::count(Instrument::SYSCALLS, 2);     // open() and close()
+
+    int fd = open(name, O_WRONLY | O_CREAT, 0666);
+    if (fd < 0)
     {
         printf("Unable to write to file: %s\n", name);
         return(1);
     }
 
-    /* At this point the file will be thought of as containing blocks
-       of BLOCKSIZE points following the header.  In a MTX file
-       the blocks for a given row of points are separated by fileincr
-       blocks of points while in single files and .SER files they are
-       contiguous.  Blocks are always aligned on these 32 point
-       boundaries. */
-    if (size < POINTSPERSEC)
-        size = POINTSPERSEC;
+    std::vector<struct iovec> iov;
+    std::vector<float> pad;
+    addBlocks(iov, data, size, nspec, pad);
 
-    /* Number of Singles to read at once */
-    fileincr = POINTSPERSEC;
-    /* Position of first block */
-    filepos = datoffset * SECSIZE / sizeof(float) + (blocknum - 1) * size;
-    pointstowrite = size * nspec; /** Current total number left to read */
-
-    /* The main writing loop */
-    index = 0;
-    while (pointstowrite > 0)
+    bool ok = writeAll(fd, iov.data(), int(iov.size()),
+                       dataOffset(blockSize(size), datoffset, blocknum));
+    if (close(fd) != 0)
+        ok = false;
+    if (!ok)
     {
-        if (pointstowrite > POINTSPERSEC)
-            npoints = POINTSPERSEC;
-        else
-            npoints = pointstowrite;
-        fseek(f1, filepos * sizeof(float), SEEK_SET);
-        pointswritten = fwrite(&data[index], sizeof(float), npoints, f1);
-        if (pointswritten != npoints)
-        {
-            printf("Unable to write to file: %s\n", name);
-            fclose(f1);
-            return(1);
-        }
-        filepos += fileincr;
-        index += pointswritten;
-        pointstowrite -= pointswritten;
+        printf("Unable to write to file: %s\n", name);
+        return(1);
     }
-    fclose(f1);
     return(0);
 }
 
-void ProNmr::createData(const std::string& inputFName, const std::string& outputFNameRoot)
+void ProNmr::writeFile(const std::string& name, const float *data, int size, int nspec)
 {
-    std::ofstream os;
-    char pOutFName[200];
+    ScopedTimer timer(Instrument::WRITE);
+    Instrument::count(Instrument::SYSCALLS, 2);     // open() and close()
 
-    // containers for the data in the file
-    const int MAXLINES = 50;
-    const unsigned NDWELLS = 1024;
-    const float PHASE_0 = 0.0;
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open file: " + name + "\n" + strerror(errno));
 
-    unsigned iLines;
-    float fDwell;
-    float fDe;
-    float pAmplitude[MAXLINES];
-    float pFreq[MAXLINES];
-    float pDamp[MAXLINES];
-    float pPhase[MAXLINES];
+    std::vector<struct iovec> iov;
+    iov.push_back({this, sizeof(ProNmr)});
 
-    for (int i = 0; i < MAXLINES; i++)
+    std::vector<char> gap;
+    std::vector<float> pad;
+    if (nspec > 0)
     {
-        pAmplitude[i] = -999.0;
-        pFreq[i] = -999.0;
-        pDamp[i] = -999.0;
-        pPhase[i] = -999.0;
+        gap.resize(size_t(dataOffset(blockSize(size), offsets[DAT], 1)) - sizeof(ProNmr));
+        iov.push_back({gap.data(), gap.size()});
+        addBlocks(iov, data, size, nspec, pad);
     }
 
-    const unsigned NSPECS = 10;
-
-    float pNoise[NSPECS] = {
-        0.00, 0.01, 0.02, 0.04, 0.08, 0.16, 0.32, 0.64, 1.28, 2.56
-    };
-
-    ProNmr Header;
-    memset(&Header, 0, sizeof(ProNmr));
-
-    // now fill what we can here
-    strcpy(Header.keyname, "\005NMR86");
-    Header.fileversion = 2;
-    Header.offsets[ACQU] = 0;
-    Header.offsets[DAT] = 2;
-    Header.si = NDWELLS * 2;
-    Header.td = NDWELLS * 2;
-    Header.nrecs = 1;
-    Header.dstatus |= AQ_SIM | SHUFF;
-    Header.ns = 1;
-    Header.sf = 100.0e6;
-    Header.o1 = 0.0;
-    Header.dw = 0.001;
-    Header.de = 0.0;
-    strcpy(Header.filename, "\008filename");
-    strcpy(Header.machineid, "\008Sim data");
-    time_t Now = time(0);
-    strcpy(Header.date, ctime(&Now));
-    Header.vd = 0.0;
-    Header.in2d = 0.0;
-    Header.sf1 = 0.0;
-    Header.o11= 0.0;
-
-    if (getInputSpecs(pInpFName, iLines, fDwell, fDe, pAmplitude,
-                pFreq, pDamp, pPhase) == false)
-        exit(1);
-
-    printf("Read %d peaks.\n", iLines);
-
-    // make some complex fids
-    ComplexfArray ComplexFid(NDWELLS);
-    for (unsigned iSpec = 0; iSpec < NSPECS; iSpec++)
+    bool ok = writeAll(fd, iov.data(), int(iov.size()), 0);
+    int error = errno;
+    if (close(fd) != 0 && ok)
     {
-        // Generate FID
-        MakeSimFid(ComplexFid, iLines, fDwell, pAmplitude, pFreq, pDamp,
-                    pPhase, PHASE_0, fDe, true);
-
-        // Add the required noise
-        addNoise(ComplexFid, pNoise[iSpec]);
-
-        // write out as a gnuplot data set
-        sprintf(pOutFName, "data/%s-%3.2f.gp", pOutFNameRoot, pNoise[iSpec]);
-        std::ofstream os(pOutFName);
-        if (!os)
-        {
-            printf("Could not open file: %s\n", pOutFName);
-            return false;
-        }
-
-        writeGnuplot(ComplexFid, os);
-        os.close();
-
-        // stream out so that it can be read later.
-        sprintf(pOutFName, "data/%s-%3.2f", pOutFNameRoot, pNoise[iSpec]);
-        os.open(pOutFName);
-        //ComplexFid.write(os);
-        os << ComplexFid;
-        os.close();
-
-        // now write out as a pronmr file
-        strcat(pOutFName, "p");
-        if (Header.writeParams(pOutFName) != 0)
-        {
-            exit(1);
-        }
-
-        float *pData = reinterpret_cast<float *>(ComplexFid.data());
-        int iNData = ComplexFid.rows() * 2;
-        if (Header.writeData(pData, pOutFName, iNData, Header.offsets[DAT], 1, 1)!= 0)
-        {
-            exit(1);
-        }
+        ok = false;
+        error = errno;
     }
-
-    return 0;
-
+    if (!ok)
+        throw std::runtime_error("Unable to write to file: " + name + "\n" + strerror(error));
 }
 
+void ProNmr::createData(const std::string& inputFName, const std::string& outputFNameRoot,
+                        const std::string& noiseFName)
+{
+    // the generation loop is the one of the nmrsim driver
+    if (::createData(inputFName.c_str(), outputFNameRoot.c_str(),
+                     noiseFName.empty() ? 0 : noiseFName.c_str()) != 0)
+        throw std::runtime_error("Unable to create data from: " + inputFName);
+}
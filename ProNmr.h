@@ -56,33 +56,46 @@ public:
 
     void init();
 
-    /* Writes the file ACQU parameters to the disk and checks to make sure
-       that all went well.  Returns 0 if all went well. */
+    /* Writes the file ACQU parameters to a new file, replacing any file
+       of that name.  Throws std::runtime_error if that fails. */
     void writeParams(const std::string& name);
 
     /*
       name:      Full file name to write to
-      size:      Number of data to read (need not be a power of 2)
+      size:      Number of data to write (need not be a power of 2), at
+                 least POINTSPERSEC (32) are written
       datoffset: Offset (units of SECSIZE bytes) of start of data
-      blocknum:  Block number to get in serial files (1 based)
-      nspec:     Number of spectra to read at once
+      blocknum:  Block number to write in serial files (1 based)
+      nspec:     Number of spectra to write at once
 
       Allows writing serial files as well as ordinary ones.
       Returns 0 if all went well.
 
-      The array is passed as a **float because dynamic memory
-      reallocation is done internally and the address of the
-      data array may change.
-
-      This is a somewhat abbreviated routine which reads in the
-      acquisition parameters and data only.  It does not have
-      the full functionality of the corresponding Prospector
-      function.
+      The blocks of the nspec spectra are contiguous and are written
+      with one pwritev() at the offset of block blocknum, so they may be
+      written in any order.  The data start at datoffset or straight
+      after the parameters, whichever is later.
     */
-    int writeData(float *data, char *name, int size, int datoffset, int blocknum,
+    int writeData(const float *data, char *name, int size, int datoffset, int blocknum,
                 int nspec);
 
-    void createData(const std::string& inputFName, const std::string& outputFNameRoot);
+    /* Writes the parameters and nspec spectra of size points from data to
+       a new file with a single pwritev().  The file is the same as one
+       written by writeParams() and then writeData(data, name, size,
+       offsets[DAT], 1, nspec).  Throws std::runtime_error on failure. */
+    void writeFile(const std::string& name, const float *data, int size, int nspec);
+
+    // floats in each block of a file with size points per spectrum
+    static int blockSize(int size);
+
+    /* Byte offset of block blocknum (1 based) of blocks of size floats in
+       a file whose data start at sector datoffset */
+    static long dataOffset(int size, int datoffset, int blocknum);
+
+    /* Runs ::createData() (nmrsim.h) and throws std::runtime_error if it
+       fails.  An empty noiseFName selects the default noise table. */
+    void createData(const std::string& inputFName, const std::string& outputFNameRoot,
+                    const std::string& noiseFName = "");
 
     /* Key word to check for validity */
     char keyname[8];   /* MUST == "\005NMR86" */
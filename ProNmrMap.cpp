@@ -0,0 +1,107 @@
+//
+//  ProNmrMap.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ProNmrMap.h"
+#include "Instrument.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+ProNmrMap::ProNmrMap(const std::string& name, const ProNmr& params, int nspec)
+    : mName(name), mFd(-1), mMap(0), mLength(0),
+      mBlockSize(ProNmr::blockSize(params.si)), mNSpec(nspec),
+      mDataStart(ProNmr::dataOffset(mBlockSize, params.offsets[DAT], 1))
+{
+    mLength = size_t(ProNmr::dataOffset(mBlockSize, params.offsets[DAT], nspec + 1));
+
+    ScopedTimer timer(Instrument::WRITE);
+    Instrument::count(Instrument::SYSCALLS, 3);     // open(), ftruncate() and mmap()
+
+    mFd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (mFd < 0)
+        throw std::runtime_error("Unable to open file: " + name + "\n" + strerror(errno));
+
+    // the file reads as zeros until it is written
+    if (ftruncate(mFd, off_t(mLength)) != 0)
+    {
+        int error = errno;
+        close(mFd);
+        throw std::runtime_error("Unable to size file: " + name + "\n" + strerror(error));
+    }
+
+    void *map = mmap(0, mLength, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (map == MAP_FAILED)
+    {
+        int error = errno;
+        close(mFd);
+        throw std::runtime_error("Unable to map file: " + name + "\n" + strerror(error));
+    }
+    mMap = static_cast<char *>(map);
+
+    std::memcpy(mMap, &params, sizeof(ProNmr));
+}
+
+// the whole file counts as written once the map is released
+ProNmrMap::~ProNmrMap()
+{
+    ScopedTimer timer(Instrument::WRITE);
+    munmap(mMap, mLength);
+    close(mFd);
+    Instrument::count(Instrument::SYSCALLS, 2);
+    Instrument::count(Instrument::BYTES_WRITTEN, mLength);
+}
+
+ProNmr& ProNmrMap::params()
+{
+    return *reinterpret_cast<ProNmr *>(mMap);
+}
+
+float *ProNmrMap::data(int blocknum)
+{
+    return reinterpret_cast<float *>(mMap + mDataStart) + long(blocknum - 1) * mBlockSize;
+}
+
+Complexf *ProNmrMap::complexData(int blocknum)
+{
+    return reinterpret_cast<Complexf *>(data(blocknum));
+}
+
+int ProNmrMap::blockSize() const
+{
+    return mBlockSize;
+}
+
+int ProNmrMap::nSpec() const
+{
+    return mNSpec;
+}
+
+void ProNmrMap::sync()
+{
+    ScopedTimer timer(Instrument::WRITE);
+    Instrument::count(Instrument::SYSCALLS, 1);
+    if (msync(mMap, mLength, MS_SYNC) != 0)
+        throw std::runtime_error("Unable to write to file: " + mName + "\n" + strerror(errno));
+}
@@ -0,0 +1,77 @@
+//
+//  ProNmrMap.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PRONMRMAP_H
+#define PRONMRMAP_H
+
+#include "DataGenerator.h"
+#include "ProNmr.h"
+
+#include <string>
+
+/* A ProNmr file mapped into memory for writing in place.
+
+   The file is sized for nspec blocks of si points starting at sector
+   offsets[DAT], with the same layout as ProNmr::writeFile(), and the
+   parameters are copied to its head.  The synthesis and noise functions can
+   then write each block straight into the page cache, with no intermediate
+   FID and no copies through stdio, which matters for large serial files.
+   The file is complete once the map is destroyed. */
+class ProNmrMap
+{
+public:
+    /**
+        name         -- file to create, replacing any file of that name
+        params       -- parameters written at the head of the file
+        nspec        -- number of blocks (spectra) in the file
+
+        Throws std::runtime_error if the file cannot be created or mapped.
+    */
+    ProNmrMap(const std::string& name, const ProNmr& params, int nspec = 1);
+    ~ProNmrMap();
+
+    ProNmrMap(const ProNmrMap&) = delete;
+    ProNmrMap& operator=(const ProNmrMap&) = delete;
+
+    // the parameters in the file
+    ProNmr& params();
+
+    // first point of block blocknum (1 based, as ProNmr::writeData())
+    float *data(int blocknum = 1);
+    Complexf *complexData(int blocknum = 1);
+
+    // floats in each block
+    int blockSize() const;
+    int nSpec() const;
+
+    // flushes the map to the file; throws std::runtime_error on failure
+    void sync();
+
+private:
+    std::string mName;
+    int mFd;
+    char *mMap;
+    size_t mLength;
+    int mBlockSize;
+    int mNSpec;
+    long mDataStart;
+};
+
+#endif // PRONMRMAP_H
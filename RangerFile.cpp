@@ -0,0 +1,479 @@
+//
+//  RangerFile.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RangerFile.h"
+#include "CpuDispatch.h"
+#include "Instrument.h"
+#include "Kernels.h"
+#include "LittleEndian.h"
+#include "SampleFormat.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = {'\x89', 'R', 'A', 'N', 'G', 'E', 'R', '\n'};
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// byte offsets of the header fields
+enum
+{
+    MAGIC_AT = 0,
+    VERSION_AT = 8,
+    HEADER_BYTES_AT = 12,
+    BYTE_ORDER_AT = 16,
+    SAMPLE_TYPE_AT = 20,
+    NPOINTS_AT = 24,
+    NSPECTRA_AT = 32,
+    CHUNK_POINTS_AT = 36,
+    NCHUNKS_AT = 40,
+    INDEX_OFFSET_AT = 48,
+    DATA_OFFSET_AT = 56,
+    FILE_BYTES_AT = 64,
+    DWELL_AT = 72,
+    PRE_DELAY_AT = 80,
+    SF_AT = 88,
+    O1_AT = 96,
+    SEED_AT = 104,
+    SCALE_AT = 112
+};
+
+static uint64_t roundUp(uint64_t n, uint64_t alignment)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+unsigned RangerFile::pointFloats(SampleType type)
+{
+    // the complex types are the odd ones
+    return type % 2 == 1 ? 2 : 1;
+}
+
+unsigned RangerFile::pointBytes(SampleType type)
+{
+    const Storage valueStorage = storage(type);
+    return pointFloats(type) * (valueStorage == FLOAT16 || valueStorage == BFLOAT16 ? 2 : 4);
+}
+
+RangerFile::Storage RangerFile::storage(SampleType type)
+{
+    return Storage((type - 1) / 2);
+}
+
+RangerFile::SampleType RangerFile::sampleType(Storage storage, bool complex)
+{
+    return SampleType(2 * storage + (complex ? 1 : 2));
+}
+
+bool RangerFile::validType(uint32_t type)
+{
+    return type >= COMPLEX_FLOAT32 && type <= REAL_INT32;
+}
+
+RangerFile::Storage RangerFile::storage(const std::string& name)
+{
+    if (name == "float32")
+        return FLOAT32;
+    if (name == "float16")
+        return FLOAT16;
+    if (name == "bfloat16")
+        return BFLOAT16;
+    if (name == "int32")
+        return SCALED_INT32;
+    throw std::invalid_argument("Unknown sample storage: " + name
+                                + " (float32, float16, bfloat16 or int32)");
+}
+
+std::vector<RangerFile::Chunk> RangerFile::layout(const Params& params)
+{
+    const uint64_t bytes = pointBytes(params.sampleType);
+    const uint64_t perSpectrum = (params.npoints + params.chunkPoints - 1) / params.chunkPoints;
+
+    std::vector<Chunk> chunks(perSpectrum * params.nspectra);
+    uint64_t offset = roundUp(HEADER_BYTES + chunks.size() * INDEX_ENTRY_BYTES, DATA_ALIGNMENT);
+    size_t i = 0;
+    for (uint32_t spectrum = 0; spectrum < params.nspectra; spectrum++)
+    {
+        for (uint64_t first = 0; first < params.npoints; first += params.chunkPoints)
+        {
+            Chunk& chunk = chunks[i++];
+            chunk.offset = offset;
+            chunk.spectrum = spectrum;
+            chunk.firstPoint = first;
+            chunk.npoints = uint32_t(std::min(uint64_t(params.chunkPoints), params.npoints - first));
+            offset += roundUp(chunk.npoints * bytes, CHUNK_ALIGNMENT);
+        }
+    }
+    return chunks;
+}
+
+uint64_t RangerFile::fileBytes(const Params& params)
+{
+    std::vector<Chunk> chunks = layout(params);
+    if (chunks.empty())
+        return roundUp(HEADER_BYTES, DATA_ALIGNMENT);
+
+    const Chunk& last = chunks.back();
+    return last.offset + roundUp(uint64_t(last.npoints) * pointBytes(params.sampleType),
+                                 CHUNK_ALIGNMENT);
+}
+
+RangerWriter::RangerWriter(const std::string& name, const RangerFile::Params& params)
+    : mName(name), mParams(params), mNWritten(0), mPointsWritten(0), mEnd(0)
+{
+    ScopedTimer timer(Instrument::WRITE);
+    if (!RangerFile::validType(mParams.sampleType))
+        throw std::invalid_argument("Unknown RANGER sample type: "
+                                    + std::to_string(mParams.sampleType));
+    if (RangerFile::storage(mParams.sampleType) == RangerFile::SCALED_INT32
+        && !(mParams.scale > 0.0))
+        throw std::invalid_argument("RANGER int32 samples need a scale > 0: " + name);
+    if (mParams.chunkPoints == 0)
+        mParams.chunkPoints = RangerFile::DEFAULT_CHUNK_POINTS;
+    mChunks = RangerFile::layout(mParams);
+
+    mOs.open(name, std::ios::binary | std::ios::trunc);
+    if (!mOs)
+        throw std::runtime_error("Unable to open file: " + name);
+
+    const uint64_t dataOffset = mChunks.empty()
+        ? RangerFile::fileBytes(mParams) : mChunks.front().offset;
+
+    // header, index and padding in one block
+    std::vector<unsigned char> head(dataOffset, 0);
+    unsigned char *h = head.data();
+    std::memcpy(h + MAGIC_AT, MAGIC, sizeof(MAGIC));
+    put32(h + VERSION_AT, RangerFile::VERSION);
+    put32(h + HEADER_BYTES_AT, RangerFile::HEADER_BYTES);
+    put32(h + BYTE_ORDER_AT, BYTE_ORDER_MARK);
+    put32(h + SAMPLE_TYPE_AT, mParams.sampleType);
+    put64(h + NPOINTS_AT, mParams.npoints);
+    put32(h + NSPECTRA_AT, mParams.nspectra);
+    put32(h + CHUNK_POINTS_AT, mParams.chunkPoints);
+    put64(h + NCHUNKS_AT, mChunks.size());
+    put64(h + INDEX_OFFSET_AT, RangerFile::HEADER_BYTES);
+    put64(h + DATA_OFFSET_AT, dataOffset);
+    put64(h + FILE_BYTES_AT, RangerFile::fileBytes(mParams));
+    putDouble(h + DWELL_AT, mParams.dwell);
+    putDouble(h + PRE_DELAY_AT, mParams.preDelay);
+    putDouble(h + SF_AT, mParams.sf);
+    putDouble(h + O1_AT, mParams.o1);
+    put64(h + SEED_AT, mParams.seed);
+    putDouble(h + SCALE_AT, mParams.scale);
+
+    unsigned char *entry = h + RangerFile::HEADER_BYTES;
+    for (const RangerFile::Chunk& chunk : mChunks)
+    {
+        put64(entry, chunk.offset);
+        put32(entry + 8, chunk.spectrum);
+        put32(entry + 12, chunk.npoints);
+        put64(entry + 16, chunk.firstPoint);
+        entry += RangerFile::INDEX_ENTRY_BYTES;
+    }
+
+    mOs.write(reinterpret_cast<const char *>(h), head.size());
+    mEnd = head.size();
+    if (!mOs)
+        throw std::runtime_error("Unable to write to file: " + name);
+    Instrument::count(Instrument::SYSCALLS, 2);     // open() and write()
+    Instrument::count(Instrument::BYTES_WRITTEN, head.size());
+}
+
+RangerWriter::~RangerWriter()
+{
+    if (mOs.is_open())
+        mOs.close();
+}
+
+void RangerWriter::write(const float *data)
+{
+    if (mNWritten >= mParams.nspectra)
+        throw std::runtime_error("Too many spectra written to file: " + mName);
+
+    write(mNWritten++, 0, mParams.npoints, data);
+}
+
+void RangerWriter::write(const double *data)
+{
+    if (mNWritten >= mParams.nspectra)
+        throw std::runtime_error("Too many spectra written to file: " + mName);
+
+    write(mNWritten++, 0, mParams.npoints, data);
+}
+
+void RangerWriter::write(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints,
+                         const float *data)
+{
+    writeSamples(spectrum, firstPoint, npoints, data);
+}
+
+void RangerWriter::write(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints,
+                         const double *data)
+{
+    writeSamples(spectrum, firstPoint, npoints, data);
+}
+
+template <typename Real>
+void RangerWriter::writeSamples(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints,
+                                const Real *data)
+{
+    if (spectrum >= mParams.nspectra || firstPoint > mParams.npoints
+        || npoints > mParams.npoints - firstPoint)
+        throw std::runtime_error("Points out of range written to file: " + mName);
+
+    ScopedTimer timer(Instrument::WRITE);
+
+    const unsigned pointFloats = RangerFile::pointFloats(mParams.sampleType);
+    const unsigned pointBytes = RangerFile::pointBytes(mParams.sampleType);
+    const uint64_t perSpectrum = (mParams.npoints + mParams.chunkPoints - 1) / mParams.chunkPoints;
+    const uint64_t end = firstPoint + npoints;
+
+    // the gaps between chunks are left as holes and read back as zeros
+    for (uint64_t point = firstPoint; point < end; )
+    {
+        const RangerFile::Chunk& chunk
+            = mChunks[spectrum * perSpectrum + point / mParams.chunkPoints];
+        const uint64_t count = std::min(chunk.firstPoint + chunk.npoints, end) - point;
+        const uint64_t offset = chunk.offset + (point - chunk.firstPoint) * pointBytes;
+        const size_t nvalues = size_t(count) * pointFloats;
+        const Real *src = data + (point - firstPoint) * pointFloats;
+
+        // the storage is settled here, once for each run of a chunk
+        switch (RangerFile::storage(mParams.sampleType))
+        {
+        case RangerFile::FLOAT32:
+            writeChunk<Float32Storage>(offset, src, nvalues);
+            break;
+        case RangerFile::FLOAT16:
+            writeChunk<Float16Storage>(offset, src, nvalues);
+            break;
+        case RangerFile::BFLOAT16:
+            writeChunk<BFloat16Storage>(offset, src, nvalues);
+            break;
+        case RangerFile::SCALED_INT32:
+            writeChunk<ScaledInt32Storage>(offset, src, nvalues);
+            break;
+        }
+        point += count;
+    }
+
+    if (!mOs)
+        throw std::runtime_error("Unable to write to file: " + mName);
+    mPointsWritten += npoints;
+}
+
+// encodeSamples() by the kernel of the instruction set in use
+template <typename Storage, typename Real>
+static void encode(unsigned char *dest, const Real *src, size_t count, double scale)
+{
+    switch (CpuDispatch::active())
+    {
+    case CpuDispatch::AVX512:
+        avx512::encodeSamples<Storage>(dest, src, count, scale);
+        break;
+    case CpuDispatch::AVX2:
+        avx2::encodeSamples<Storage>(dest, src, count, scale);
+        break;
+    default:
+        baseline::encodeSamples<Storage>(dest, src, count, scale);
+        break;
+    }
+}
+
+// writes count values from src at offset, converted to Storage
+template <typename Storage, typename Real>
+void RangerWriter::writeChunk(uint64_t offset, const Real *src, size_t count)
+{
+    const size_t bytes = count * Storage::BYTES;
+
+    mOs.seekp(std::streamoff(offset));
+    if (std::is_same<Storage, Float32Storage>::value && std::is_same<Real, float>::value
+        && littleEndianHost())
+    {
+        mOs.write(reinterpret_cast<const char *>(src), bytes);
+    }
+    else
+    {
+        mBuffer.resize(bytes);
+        encode<Storage>(mBuffer.data(), src, count, mParams.scale);
+        mOs.write(reinterpret_cast<const char *>(mBuffer.data()), bytes);
+    }
+    mEnd = std::max(mEnd, offset + bytes);
+
+    // a seek and a write, the stream buffer being flushed by the seek
+    Instrument::count(Instrument::SYSCALLS, 2);
+    Instrument::count(Instrument::BYTES_WRITTEN, bytes);
+}
+
+void RangerWriter::close()
+{
+    if (mPointsWritten != mParams.npoints * mParams.nspectra)
+        throw std::runtime_error("Not all spectra written to file: " + mName);
+
+    ScopedTimer timer(Instrument::WRITE);
+    Instrument::count(Instrument::SYSCALLS, 3);     // seek, write and close()
+    Instrument::count(Instrument::BYTES_WRITTEN, RangerFile::fileBytes(mParams) - mEnd);
+
+    // padding after the last chunk
+    static const char zeros[RangerFile::CHUNK_ALIGNMENT] = {};
+    mOs.seekp(std::streamoff(mEnd));
+    mOs.write(zeros, RangerFile::fileBytes(mParams) - mEnd);
+    mOs.close();
+    if (!mOs)
+        throw std::runtime_error("Unable to write to file: " + mName);
+}
+
+const RangerFile::Params& RangerWriter::params() const
+{
+    return mParams;
+}
+
+RangerReader::RangerReader(const std::string& name)
+    : mName(name), mMap(0), mLength(0)
+{
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open file: " + name + "\n" + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < RangerFile::HEADER_BYTES)
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a RANGER file: " + name);
+    }
+
+    mLength = size_t(st.st_size);
+    void *map = mmap(0, mLength, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("Unable to map file: " + name + "\n" + strerror(errno));
+    mMap = static_cast<const unsigned char *>(map);
+
+    const unsigned char *h = mMap;
+    if (std::memcmp(h + MAGIC_AT, MAGIC, sizeof(MAGIC)) != 0
+        || get32(h + BYTE_ORDER_AT) != BYTE_ORDER_MARK
+        || get32(h + VERSION_AT) != RangerFile::VERSION)
+    {
+        munmap(const_cast<unsigned char *>(mMap), mLength);
+        throw std::runtime_error("Not a RANGER file of version 1: " + name);
+    }
+
+    mParams.sampleType = RangerFile::SampleType(get32(h + SAMPLE_TYPE_AT));
+    mParams.npoints = get64(h + NPOINTS_AT);
+    mParams.nspectra = get32(h + NSPECTRA_AT);
+    mParams.chunkPoints = get32(h + CHUNK_POINTS_AT);
+    mParams.dwell = getDouble(h + DWELL_AT);
+    mParams.preDelay = getDouble(h + PRE_DELAY_AT);
+    mParams.sf = getDouble(h + SF_AT);
+    mParams.o1 = getDouble(h + O1_AT);
+    mParams.seed = get64(h + SEED_AT);
+    mParams.scale = getDouble(h + SCALE_AT);
+
+    const uint64_t nchunks = get64(h + NCHUNKS_AT);
+    const uint64_t indexOffset = get64(h + INDEX_OFFSET_AT);
+    if (!RangerFile::validType(get32(h + SAMPLE_TYPE_AT))
+        || (RangerFile::storage(mParams.sampleType) == RangerFile::SCALED_INT32
+            && !(mParams.scale > 0.0))
+        || mParams.chunkPoints == 0
+        || get64(h + FILE_BYTES_AT) > mLength
+        || indexOffset + nchunks * RangerFile::INDEX_ENTRY_BYTES > mLength)
+    {
+        munmap(const_cast<unsigned char *>(mMap), mLength);
+        throw std::runtime_error("Damaged RANGER file: " + name);
+    }
+
+    const uint64_t pointBytes = RangerFile::pointBytes(mParams.sampleType);
+    mChunks.resize(nchunks);
+    for (uint64_t i = 0; i < nchunks; i++)
+    {
+        const unsigned char *entry = mMap + indexOffset + i * RangerFile::INDEX_ENTRY_BYTES;
+        RangerFile::Chunk& chunk = mChunks[i];
+        chunk.offset = get64(entry);
+        chunk.spectrum = get32(entry + 8);
+        chunk.npoints = get32(entry + 12);
+        chunk.firstPoint = get64(entry + 16);
+
+        if (chunk.offset + chunk.npoints * pointBytes > mLength
+            || chunk.spectrum >= mParams.nspectra
+            || chunk.firstPoint + chunk.npoints > mParams.npoints)
+        {
+            munmap(const_cast<unsigned char *>(mMap), mLength);
+            throw std::runtime_error("Damaged RANGER file: " + name);
+        }
+    }
+}
+
+RangerReader::~RangerReader()
+{
+    munmap(const_cast<unsigned char *>(mMap), mLength);
+}
+
+const RangerFile::Params& RangerReader::params() const
+{
+    return mParams;
+}
+
+const std::vector<RangerFile::Chunk>& RangerReader::chunks() const
+{
+    return mChunks;
+}
+
+const float *RangerReader::chunkData(size_t chunk) const
+{
+    if (!littleEndianHost() || RangerFile::storage(mParams.sampleType) != RangerFile::FLOAT32)
+        return 0;
+    return reinterpret_cast<const float *>(mMap + mChunks[chunk].offset);
+}
+
+void RangerReader::read(uint32_t spectrum, float *data) const
+{
+    const unsigned pointFloats = RangerFile::pointFloats(mParams.sampleType);
+    for (const RangerFile::Chunk& chunk : mChunks)
+    {
+        if (chunk.spectrum != spectrum)
+            continue;
+
+        float *dest = data + chunk.firstPoint * pointFloats;
+        const unsigned char *src = mMap + chunk.offset;
+        const size_t count = size_t(chunk.npoints) * pointFloats;
+        switch (RangerFile::storage(mParams.sampleType))
+        {
+        case RangerFile::FLOAT32:
+            copyFloats(dest, src, count);
+            break;
+        case RangerFile::FLOAT16:
+            decodeSamples<Float16Storage>(dest, src, count, mParams.scale);
+            break;
+        case RangerFile::BFLOAT16:
+            decodeSamples<BFloat16Storage>(dest, src, count, mParams.scale);
+            break;
+        case RangerFile::SCALED_INT32:
+            decodeSamples<ScaledInt32Storage>(dest, src, count, mParams.scale);
+            break;
+        }
+    }
+}
@@ -0,0 +1,208 @@
+//
+//  RangerFile.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RANGERFILE_H
+#define RANGERFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* The RANGER data format: a binary container for one or more FIDs that
+   can be mapped into memory or read as a stream without any parsing.
+
+   Every field is little-endian whatever the host.  The file is
+
+     header       HEADER_BYTES bytes, fields at the offsets in RangerFile.cpp
+     chunk index  one INDEX_ENTRY_BYTES entry per chunk
+     padding      to a multiple of DATA_ALIGNMENT bytes
+     chunks       each spectrum cut into chunks of chunkPoints points, every
+                  chunk starting on a CHUNK_ALIGNMENT byte boundary
+
+   The header starts with the magic "\x89RANGER\n", the format version and
+   a byte order mark, and holds the acquisition parameters.  The layout of
+   the chunks follows from the header alone and the index is written
+   before the data, so a reader of a stream knows where everything is
+   before it arrives, and a reader of a mapped file can go straight to any
+   chunk.  Samples are interleaved real and imaginary for complex data,
+   each value stored as set by the sample type (see SampleFormat.h):
+   IEEE float32, float16 or bfloat16, or int32 scaled by the header's
+   scale. */
+class RangerFile
+{
+public:
+    enum SampleType
+    {
+        COMPLEX_FLOAT32 = 1,
+        REAL_FLOAT32 = 2,
+        COMPLEX_FLOAT16 = 3,
+        REAL_FLOAT16 = 4,
+        COMPLEX_BFLOAT16 = 5,
+        REAL_BFLOAT16 = 6,
+        COMPLEX_INT32 = 7,
+        REAL_INT32 = 8
+    };
+
+    // how each value of a sample type is stored
+    enum Storage
+    {
+        FLOAT32, FLOAT16, BFLOAT16, SCALED_INT32
+    };
+
+    enum
+    {
+        VERSION = 1,
+        HEADER_BYTES = 256,
+        INDEX_ENTRY_BYTES = 32,
+        DATA_ALIGNMENT = 4096,
+        CHUNK_ALIGNMENT = 64,
+        DEFAULT_CHUNK_POINTS = 16384
+    };
+
+    struct Params
+    {
+        SampleType sampleType;
+        uint64_t npoints;       // per spectrum
+        uint32_t nspectra;
+        uint32_t chunkPoints;
+        double dwell;           // (s)
+        double preDelay;        // (s)
+        double sf;              // spectrometer frequency (Hz)
+        double o1;              // observe offset (Hz)
+        uint64_t seed;          // of the noise generator
+        double scale;           // int32 value = round(value * scale), SCALED_INT32 only
+    };
+
+    struct Chunk
+    {
+        uint64_t offset;        // bytes from the start of the file
+        uint32_t spectrum;
+        uint32_t npoints;
+        uint64_t firstPoint;
+    };
+
+    // values per point: 2 for complex types, 1 for real ones
+    static unsigned pointFloats(SampleType type);
+
+    // bytes per point
+    static unsigned pointBytes(SampleType type);
+
+    static Storage storage(SampleType type);
+
+    // the complex or real sample type of storage
+    static SampleType sampleType(Storage storage, bool complex);
+
+    // whether type is one of the SampleType values
+    static bool validType(uint32_t type);
+
+    /* Reads a storage name: float32, float16, bfloat16 or int32.  Throws
+       std::invalid_argument for any other. */
+    static Storage storage(const std::string& name);
+
+    // the chunks of a file with these parameters, in file order
+    static std::vector<Chunk> layout(const Params& params);
+
+    // total bytes of a file with these parameters
+    static uint64_t fileBytes(const Params& params);
+};
+
+/* Writes a RANGER file one spectrum at a time, or in pieces of spectra in
+   any order, so that an FID longer than memory allows can be written as it
+   is made.  Errors throw std::runtime_error. */
+class RangerWriter
+{
+public:
+    /**
+        name         -- file to create, replacing any file of that name
+        params       -- sizes and acquisition parameters; chunkPoints of 0
+                        selects RangerFile::DEFAULT_CHUNK_POINTS.  An
+                        unknown sample type, or an int32 one without a
+                        scale > 0, throws std::invalid_argument.
+    */
+    RangerWriter(const std::string& name, const RangerFile::Params& params);
+    ~RangerWriter();
+
+    /* Appends the next spectrum, params().npoints points of pointFloats()
+       values, each rounded to the storage of the sample type. */
+    void write(const float *data);
+    void write(const double *data);
+
+    /* Writes points firstPoint .. firstPoint + npoints - 1 of spectrum (0
+       based) from data.  Every point must be written exactly once before
+       close(); write(data) counts only its own calls, so the two should not
+       be mixed for the same spectrum. */
+    void write(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints, const float *data);
+    void write(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints, const double *data);
+
+    // checks that every point was written and closes the file
+    void close();
+
+    const RangerFile::Params& params() const;
+
+private:
+    template <typename Real>
+    void writeSamples(uint32_t spectrum, uint64_t firstPoint, uint64_t npoints,
+                      const Real *data);
+    template <typename Storage, typename Real>
+    void writeChunk(uint64_t offset, const Real *src, size_t count);
+
+    std::string mName;
+    RangerFile::Params mParams;
+    std::vector<RangerFile::Chunk> mChunks;
+    std::ofstream mOs;
+    std::vector<unsigned char> mBuffer;     // samples converted to the storage
+    uint32_t mNWritten;         // spectra written by write(data)
+    uint64_t mPointsWritten;
+    uint64_t mEnd;              // of the data written so far
+};
+
+/* Reads a RANGER file by mapping it into memory.  On little-endian hosts
+   float32 samples can be used in place.  Errors, including a file that is not
+   a valid RANGER file, throw std::runtime_error. */
+class RangerReader
+{
+public:
+    explicit RangerReader(const std::string& name);
+    ~RangerReader();
+
+    RangerReader(const RangerReader&) = delete;
+    RangerReader& operator=(const RangerReader&) = delete;
+
+    const RangerFile::Params& params() const;
+    const std::vector<RangerFile::Chunk>& chunks() const;
+
+    /* The samples of a chunk in place; null on big-endian hosts and for
+       storage other than float32. */
+    const float *chunkData(size_t chunk) const;
+
+    /* Copies spectrum (0 based) to data, npoints points of pointFloats()
+       floats, converting them from their storage. */
+    void read(uint32_t spectrum, float *data) const;
+
+private:
+    std::string mName;
+    RangerFile::Params mParams;
+    std::vector<RangerFile::Chunk> mChunks;
+    const unsigned char *mMap;
+    size_t mLength;
+};
+
+#endif // RANGERFILE_H
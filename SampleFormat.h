@@ -0,0 +1,219 @@
+//
+//  SampleFormat.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SAMPLEFORMAT_H
+#define SAMPLEFORMAT_H
+
+#include "LittleEndian.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* The ways the binary formats can store a sample, and the conversions to
+   and from them.  The synthesis can sum in float or double (see
+   DataGenerator::Precision) and the samples are rounded once, to the
+   storage, when they are written.
+
+     Float32Storage       IEEE binary32
+     Float16Storage       IEEE binary16: 11 bit significand, largest 65504
+     BFloat16Storage      the top half of a binary32: 8 bit significand
+     ScaledInt32Storage   round(value * scale), saturated to +-(2^31 - 1)
+
+   Every conversion rounds to nearest even.  Doubles go to the 16 bit forms
+   by way of float, which can round a value exactly half way between two
+   of them the wrong way; that is well below the error of the storage. */
+
+// binary32 to binary16, overflowing to infinity and keeping NaNs
+inline uint16_t floatToHalf(float value)
+{
+    const uint32_t F32_INFINITY = 255u << 23;
+    const uint32_t F16_OVERFLOW = (127u + 16) << 23;      // 65536
+    const uint32_t F16_NORMAL = 113u << 23;               // 2^-14
+    const uint32_t DENORMAL_MAGIC = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+
+    uint16_t half;
+    if (bits >= F16_OVERFLOW)
+    {
+        // NaNs are quieted and keep the top of their payload, as F16C does
+        half = bits > F32_INFINITY ? uint16_t(0x7e00 | ((bits >> 13) & 0x3ff)) : 0x7c00;
+    }
+    else if (bits < F16_NORMAL)
+    {
+        // the float addition does the rounding of the denormal
+        float magic, sum;
+        std::memcpy(&magic, &DENORMAL_MAGIC, 4);
+        std::memcpy(&sum, &bits, 4);
+        sum += magic;
+        std::memcpy(&bits, &sum, 4);
+        half = uint16_t(bits - DENORMAL_MAGIC);
+    }
+    else
+    {
+        const uint32_t odd = (bits >> 13) & 1;
+        bits += ((15u - 127) << 23) + 0xfff + odd;
+        half = uint16_t(bits >> 13);
+    }
+    return half | sign;
+}
+
+inline float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+
+    if (exponent == 0)
+    {
+        float value = std::ldexp(float(mantissa), -24);
+        return sign != 0 ? -value : value;
+    }
+
+    uint32_t bits = exponent == 31
+        ? sign | 0x7f800000 | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+inline uint16_t floatToBFloat16(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    if ((bits & 0x7fffffff) > 0x7f800000)
+        return uint16_t((bits >> 16) | 0x40);     // quiet NaN
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return uint16_t(bits >> 16);
+}
+
+inline float bfloat16ToFloat(uint16_t bf16)
+{
+    uint32_t bits = uint32_t(bf16) << 16;
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+inline int32_t toScaledInt32(double value, double scale)
+{
+    const double LIMIT = 2147483647.0;
+    double scaled = std::nearbyint(value * scale);
+    if (!(scaled > -LIMIT))
+        return scaled < 0.0 ? -2147483647 : 0;      // NaN is stored as 0
+    return int32_t(scaled < LIMIT ? scaled : LIMIT);
+}
+
+/* Each storage has BYTES per value and puts a float or double value at p
+   (little-endian) and gets it back as a float.  scale is used only by
+   ScaledInt32Storage. */
+struct Float32Storage
+{
+    static const unsigned BYTES = 4;
+
+    template <typename Real>
+    static void put(unsigned char *p, Real value, double)
+    {
+        float f = float(value);
+        uint32_t bits;
+        std::memcpy(&bits, &f, 4);
+        put32(p, bits);
+    }
+
+    static float get(const unsigned char *p, double)
+    {
+        uint32_t bits = get32(p);
+        float value;
+        std::memcpy(&value, &bits, 4);
+        return value;
+    }
+};
+
+struct Float16Storage
+{
+    static const unsigned BYTES = 2;
+
+    template <typename Real>
+    static void put(unsigned char *p, Real value, double)
+    {
+        put16(p, floatToHalf(float(value)));
+    }
+
+    static float get(const unsigned char *p, double)
+    {
+        return halfToFloat(get16(p));
+    }
+};
+
+struct BFloat16Storage
+{
+    static const unsigned BYTES = 2;
+
+    template <typename Real>
+    static void put(unsigned char *p, Real value, double)
+    {
+        put16(p, floatToBFloat16(float(value)));
+    }
+
+    static float get(const unsigned char *p, double)
+    {
+        return bfloat16ToFloat(get16(p));
+    }
+};
+
+struct ScaledInt32Storage
+{
+    static const unsigned BYTES = 4;
+
+    template <typename Real>
+    static void put(unsigned char *p, Real value, double scale)
+    {
+        put32(p, uint32_t(toScaledInt32(double(value), scale)));
+    }
+
+    static float get(const unsigned char *p, double scale)
+    {
+        return float(double(int32_t(get32(p))) / scale);
+    }
+};
+
+// stores count values from src at dest
+template <typename Storage, typename Real>
+void encodeSamples(unsigned char *dest, const Real *src, size_t count, double scale)
+{
+    for (size_t i = 0; i < count; i++, dest += Storage::BYTES)
+        Storage::put(dest, src[i], scale);
+}
+
+// reads count values stored at src into dest
+template <typename Storage>
+void decodeSamples(float *dest, const unsigned char *src, size_t count, double scale)
+{
+    for (size_t i = 0; i < count; i++, src += Storage::BYTES)
+        dest[i] = Storage::get(src, scale);
+}
+
+#endif // SAMPLEFORMAT_H
@@ -0,0 +1,148 @@
+//
+//  SampleFormatVectors.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SAMPLEFORMATVECTORS_H
+#define SAMPLEFORMATVECTORS_H
+
+#include "Kernels.h"
+#include "VecMath.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* The conversions of SampleFormat.h a vector at a time, for the
+   instruction set of the file that includes this one (see VecMath.h).
+   They give the same bits as the scalar ones, which still do the ends of
+   a run and everything on a big-endian host. */
+
+namespace VEC_ISA
+{
+
+inline VecF vecFloats(const float *src)
+{
+    return vecLoad(src);
+}
+
+inline VecF vecFloats(const double *src)
+{
+    return __builtin_convertvector(vecLoad(src), VecF);
+}
+
+inline VecD vecDoubles(const float *src)
+{
+    return __builtin_convertvector(vecLoad(src), VecD);
+}
+
+inline VecD vecDoubles(const double *src)
+{
+    return vecLoad(src);
+}
+
+// VEC_LANES values from src stored at dest
+template <typename Real>
+void encodeVector(Float32Storage, unsigned char *dest, const Real *src, double /*scale*/)
+{
+    VecF v = vecFloats(src);
+    std::memcpy(dest, &v, sizeof(v));
+}
+
+template <typename Real>
+void encodeVector(Float16Storage, unsigned char *dest, const Real *src, double /*scale*/)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && VEC_LANES >= 8
+    // F16C, eight at a time
+    VecF v = vecFloats(src);
+    for (int i = 0; i < VEC_LANES; i += 8)
+    {
+        __m256 floats;
+        std::memcpy(&floats, reinterpret_cast<const float *>(&v) + i, sizeof(floats));
+        __m128i halves = _mm256_cvtps_ph(floats, _MM_FROUND_TO_NEAREST_INT);
+        std::memcpy(dest + 2 * i, &halves, sizeof(halves));
+    }
+#else
+    // lane by lane is slower than the scalar loop
+    ::encodeSamples<Float16Storage>(dest, src, VEC_LANES, 1.0);
+#endif
+}
+
+template <typename Real>
+void encodeVector(BFloat16Storage, unsigned char *dest, const Real *src, double /*scale*/)
+{
+    VecU bits = (VecU)vecFloats(src);
+    VecU nan = (VecU)((bits & 0x7fffffff) > 0x7f800000);
+    VecU rounded = (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+    VecU quiet = (bits >> 16) | 0x40;
+    VecS halves = __builtin_convertvector((quiet & nan) | (rounded & ~nan), VecS);
+    std::memcpy(dest, &halves, sizeof(halves));
+}
+
+template <typename Real>
+void encodeVector(ScaledInt32Storage, unsigned char *dest, const Real *src, double scale)
+{
+    const VecD LIMIT = VecD{} + 2147483647.0;
+    // adding and taking away 1.5 * 2^52 rounds to the nearest even integer
+    const VecD ROUND = VecD{} + 6755399441055744.0;
+
+    VecD x = vecDoubles(src) * scale;
+    const VecL number = x == x;
+    x = vecSelect(x < LIMIT, x, LIMIT);
+    x = vecSelect(x > -LIMIT, x, -LIMIT);
+    x = vecSelect(number, (x + ROUND) - ROUND, VecD{});      // NaN is stored as 0
+
+    VecI values = __builtin_convertvector(x, VecI);
+    std::memcpy(dest, &values, sizeof(values));
+}
+
+template <typename Storage, typename Real>
+void encodeSamples(unsigned char *dest, const Real *src, size_t count, double scale)
+{
+    size_t i = 0;
+    if (littleEndianHost())
+    {
+        for (; i + VEC_LANES <= count; i += VEC_LANES)
+            encodeVector(Storage(), dest + i * Storage::BYTES, src + i, scale);
+    }
+    ::encodeSamples<Storage>(dest + i * Storage::BYTES, src + i, count - i, scale);
+}
+
+// the storages and sample types of RangerWriter
+template void encodeSamples<Float32Storage, float>(unsigned char *, const float *, size_t,
+                                                   double);
+template void encodeSamples<Float32Storage, double>(unsigned char *, const double *, size_t,
+                                                    double);
+template void encodeSamples<Float16Storage, float>(unsigned char *, const float *, size_t,
+                                                   double);
+template void encodeSamples<Float16Storage, double>(unsigned char *, const double *, size_t,
+                                                    double);
+template void encodeSamples<BFloat16Storage, float>(unsigned char *, const float *, size_t,
+                                                    double);
+template void encodeSamples<BFloat16Storage, double>(unsigned char *, const double *, size_t,
+                                                     double);
+template void encodeSamples<ScaledInt32Storage, float>(unsigned char *, const float *, size_t,
+                                                       double);
+template void encodeSamples<ScaledInt32Storage, double>(unsigned char *, const double *,
+                                                        size_t, double);
+
+} // namespace VEC_ISA
+
+#endif // SAMPLEFORMATVECTORS_H
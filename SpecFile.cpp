@@ -0,0 +1,259 @@
+//
+//  SpecFile.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SpecFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SpecFile::SpecFile(const std::string& name)
+    : mName(name), mMap(0), mLength(0), mPos(0), mEnd(0), mLine(1), mLineStart(0)
+{
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open file: " + name + "\n" + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Unable to read file: " + name + "\n" + strerror(error));
+    }
+
+    // an empty file cannot be mapped but parses the same as any other
+    mLength = size_t(st.st_size);
+    if (mLength > 0)
+    {
+        void *map = mmap(0, mLength, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Unable to map file: " + name + "\n" + strerror(error));
+        }
+        mMap = static_cast<const char *>(map);
+        madvise(map, mLength, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    mPos = mMap;
+    mEnd = mMap + mLength;
+    mLineStart = mMap;
+}
+
+SpecFile::~SpecFile()
+{
+    if (mMap != 0)
+        munmap(const_cast<char *>(mMap), mLength);
+}
+
+void SpecFile::fail(const std::string& message) const
+{
+    throw std::runtime_error(mName + ":" + std::to_string(mLine) + ":"
+                             + std::to_string(mPos - mLineStart + 1) + ": " + message);
+}
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// skips blanks, and newlines too if newlines is true
+void SpecFile::skipSpace(bool newlines)
+{
+    while (mPos < mEnd)
+    {
+        const char c = *mPos;
+        if (c == '\n')
+        {
+            if (!newlines)
+                return;
+            mLine++;
+            mLineStart = mPos + 1;
+        }
+        else if (!isBlank(c))
+        {
+            return;
+        }
+        mPos++;
+    }
+}
+
+// the end of the token at mPos
+const char *SpecFile::numberEnd() const
+{
+    const char *p = mPos;
+    while (p < mEnd && *p != '\n' && !isBlank(*p))
+        p++;
+    return p;
+}
+
+float SpecFile::readFloat(const char *what)
+{
+    skipSpace(true);
+    if (mPos == mEnd)
+        fail(std::string("expected ") + what + ", found the end of the file");
+
+    // from_chars does not take a leading '+'
+    const char *begin = mPos;
+    if (*begin == '+' && begin + 1 < mEnd && *(begin + 1) != '-')
+        begin++;
+
+    float value;
+    const char *end = numberEnd();
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    if (result.ec == std::errc::result_out_of_range)
+        fail(std::string(what) + " is out of range: " + std::string(mPos, end));
+    if (result.ec != std::errc() || result.ptr != end)
+        fail(std::string("expected ") + what + ", found \"" + std::string(mPos, end) + "\"");
+
+    mPos = end;
+    return value;
+}
+
+long SpecFile::readLong(const char *what)
+{
+    skipSpace(true);
+    if (mPos == mEnd)
+        fail(std::string("expected ") + what + ", found the end of the file");
+
+    const char *begin = mPos;
+    if (*begin == '+' && begin + 1 < mEnd && *(begin + 1) != '-')
+        begin++;
+
+    long value;
+    const char *end = numberEnd();
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    if (result.ec == std::errc::result_out_of_range)
+        fail(std::string(what) + " is out of range: " + std::string(mPos, end));
+    if (result.ec != std::errc() || result.ptr != end)
+        fail(std::string("expected ") + what + " (an integer), found \""
+             + std::string(mPos, end) + "\"");
+
+    mPos = end;
+    return value;
+}
+
+size_t SpecFile::readLines(std::vector<float>& amplitude, std::vector<float>& freq,
+                           std::vector<float>& damp, std::vector<float>& phase)
+{
+    // at most one row per remaining newline, plus an unterminated last one
+    size_t rows = 1;
+    for (const char *p = mPos; p < mEnd; p++)
+    {
+        p = static_cast<const char *>(std::memchr(p, '\n', mEnd - p));
+        if (p == 0)
+            break;
+        rows++;
+    }
+    amplitude.reserve(amplitude.size() + rows);
+    freq.reserve(freq.size() + rows);
+    damp.reserve(damp.size() + rows);
+    phase.reserve(phase.size() + rows);
+
+    static const char *const NAMES[4] = {"the amplitude", "the frequency", "the damping",
+                                         "the phase"};
+    std::vector<float> *const columns[4] = {&amplitude, &freq, &damp, &phase};
+
+    size_t nlines = 0;
+    for (;;)
+    {
+        skipSpace(true);
+        if (mPos == mEnd)
+            break;
+
+        // a row must be complete on its own line
+        for (int i = 0; i < 4; i++)
+        {
+            if (i > 0)
+            {
+                skipSpace(false);
+                if (mPos == mEnd || *mPos == '\n')
+                    fail(std::string("expected ") + NAMES[i] + ", found the end of the line");
+            }
+            columns[i]->push_back(readFloat(NAMES[i]));
+        }
+
+        skipSpace(false);
+        if (mPos != mEnd && *mPos != '\n')
+            fail("expected the end of the line after the phase, found \""
+                 + std::string(mPos, numberEnd()) + "\"");
+        nlines++;
+    }
+
+    return nlines;
+}
+
+void SpecFile::write(const std::string& name, long fidSize, float dwell, float preDelay,
+                     size_t nlines, const float *amplitude, const float *freq,
+                     const float *damp, const float *phase)
+{
+    std::ofstream os(name, std::ios::binary | std::ios::trunc);
+    if (!os)
+        throw std::runtime_error("Unable to open file: " + name);
+
+    // a row is at most four numbers of 15 characters and their separators
+    const size_t BUFFER_BYTES = 1 << 16;
+    const size_t ROW_BYTES = 4 * 16;
+    std::vector<char> buffer(BUFFER_BYTES);
+    char *out = buffer.data();
+    char *const limit = buffer.data() + BUFFER_BYTES - ROW_BYTES;
+
+    if (fidSize != NO_FID_SIZE)
+    {
+        out = std::to_chars(out, limit, fidSize).ptr;
+        *out++ = ' ';
+    }
+    out = std::to_chars(out, limit, dwell).ptr;
+    *out++ = ' ';
+    out = std::to_chars(out, limit, preDelay).ptr;
+    *out++ = '\n';
+
+    for (size_t i = 0; i < nlines; i++)
+    {
+        if (out > limit)
+        {
+            os.write(buffer.data(), out - buffer.data());
+            out = buffer.data();
+        }
+
+        const float row[4] = {amplitude[i], freq[i], damp[i], phase[i]};
+        for (int j = 0; j < 4; j++)
+        {
+            out = std::to_chars(out, out + 16, row[j]).ptr;
+            *out++ = j < 3 ? ' ' : '\n';
+        }
+    }
+    os.write(buffer.data(), out - buffer.data());
+
+    os.close();
+    if (!os)
+        throw std::runtime_error("Unable to write to file: " + name);
+}
@@ -0,0 +1,84 @@
+//
+//  SpecFile.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SPECFILE_H
+#define SPECFILE_H
+
+#include <string>
+#include <vector>
+
+/* A text file of simulation parameters, mapped into memory and parsed with
+   std::from_chars.
+
+   The files start with a few single parameters and go on with a line list,
+   one line per row: amplitude, frequency, damping and phase.  Numbers are
+   separated by white space and rows by newlines; blank lines are skipped.
+   Nothing is copied or allocated per number and the line list goes
+   straight into vectors reserved from a count of the rows, so there is no
+   limit on the number of lines other than memory.
+
+   Errors throw std::runtime_error with a message of the form
+   "file:line:column: what went wrong". */
+class SpecFile
+{
+public:
+    // maps the file; throws std::runtime_error if it cannot be read
+    explicit SpecFile(const std::string& name);
+    ~SpecFile();
+
+    SpecFile(const SpecFile&) = delete;
+    SpecFile& operator=(const SpecFile&) = delete;
+
+    // the next number, anywhere after the current position; what names it in errors
+    float readFloat(const char *what);
+    long readLong(const char *what);
+
+    /* Reads the rest of the file as rows of amplitude, freq, damp and phase,
+       appending to the vectors, and returns the number of rows. */
+    size_t readLines(std::vector<float>& amplitude, std::vector<float>& freq,
+                     std::vector<float>& damp, std::vector<float>& phase);
+
+    // fidSize of write() for the files of nmrsim, which start with the dwell
+    static const long NO_FID_SIZE = -1;
+
+    /* Writes the FID size, dwell and pre-acquisition delay and then nlines
+       rows from the arrays, as DataGenerator::InputSpecs::read() reads
+       them, replacing any file of that name.  With NO_FID_SIZE the FID size
+       is left out, as getInputSpecs() (nmrsim.h) reads them.  Each number
+       is the shortest text that reads back as the same float. */
+    static void write(const std::string& name, long fidSize, float dwell, float preDelay,
+                      size_t nlines, const float *amplitude, const float *freq,
+                      const float *damp, const float *phase);
+
+private:
+    void skipSpace(bool newlines);
+    const char *numberEnd() const;
+    [[noreturn]] void fail(const std::string& message) const;
+
+    std::string mName;
+    const char *mMap;
+    size_t mLength;
+    const char *mPos;
+    const char *mEnd;
+    long mLine;             // of mPos, 1 based
+    const char *mLineStart;
+};
+
+#endif // SPECFILE_H
@@ -0,0 +1,236 @@
+//
+//  VecMath.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <cstring>
+
+/* Short float vectors for the kernels of Kernels.h.  This file is
+   included by KernelsBaseline.cpp, KernelsAvx2.cpp and KernelsAvx512.cpp,
+   each of which sets VEC_LANES to the float lanes of the instruction set it
+   is compiled for, SSE2 (4), AVX2 (8) or AVX-512 (16), and VEC_ISA to the
+   namespace that keeps its types and functions apart from the others'.
+   VecD has as many double lanes, in two registers, so that the kernels
+   can be compiled for either precision with the same arrangement of
+   lines. */
+#if !defined(VEC_LANES) || !defined(VEC_ISA)
+#error "VecMath.h needs VEC_LANES and VEC_ISA (see KernelsBaseline.cpp)"
+#endif
+
+/* VecD is wider than the vectors of the instruction set.  The vectors
+   never leave the file that includes this one, so the ABI of returning
+   them does not matter there and the -Wpsabi warnings about it are turned
+   off.  GCC's note about passing them as parameters ignores the pragma,
+   so VecD and VecL are passed by reference. */
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace VEC_ISA
+{
+
+typedef float VecF __attribute__((vector_size(VEC_LANES * sizeof(float))));
+typedef int VecI __attribute__((vector_size(VEC_LANES * sizeof(int))));
+typedef unsigned VecU __attribute__((vector_size(VEC_LANES * sizeof(unsigned))));
+typedef unsigned short VecS __attribute__((vector_size(VEC_LANES * sizeof(unsigned short))));
+typedef double VecD __attribute__((vector_size(VEC_LANES * sizeof(double))));
+typedef long long VecL __attribute__((vector_size(VEC_LANES * sizeof(long long))));
+
+// the vector of VEC_LANES Real lanes
+template <typename Real>
+struct Vec;
+
+template <>
+struct Vec<float>
+{
+    typedef VecF Type;
+};
+
+template <>
+struct Vec<double>
+{
+    typedef VecD Type;
+};
+
+inline VecF vecLoad(const float *p)
+{
+    VecF v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void vecStore(float *p, VecF v)
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline VecD vecLoad(const double *p)
+{
+    VecD v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void vecStore(double *p, const VecD& v)
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+/* mask ? a : b for each lane, mask being all ones or all zeros.  GCC
+   lowers ?: on vectors of two registers to branches. */
+inline VecD vecSelect(const VecL& mask, const VecD& a, const VecD& b)
+{
+    return (VecD)(((VecL)a & mask) | ((VecL)b & ~mask));
+}
+
+inline VecF vecBroadcast(float f)
+{
+    return VecF{} + f;
+}
+
+inline float vecSum(VecF v)
+{
+    float sum = 0.0;
+    for (int i = 0; i < VEC_LANES; i++)
+        sum += v[i];
+    return sum;
+}
+
+inline double vecSum(const VecD& v)
+{
+    double sum = 0.0;
+    for (int i = 0; i < VEC_LANES; i++)
+        sum += v[i];
+    return sum;
+}
+
+/* Sine and cosine of every lane using the Cephes single precision
+   polynomials.  Accurate to about 1 ulp for |x| < 8192; callers keep their
+   arguments reduced well inside that range. */
+inline void vecSinCos(VecF x, VecF& s, VecF& c)
+{
+    const VecI signMask = VecI{} + int(0x80000000);
+
+    VecI xBits = (VecI)x;
+    VecI signSin = xBits & signMask;
+    x = (VecF)(xBits & ~signMask);
+
+    // octant, rounded up to an even value
+    VecI j = __builtin_convertvector(x * 1.27323954473516f, VecI);
+    j = (j + 1) & ~1;
+    VecF y = __builtin_convertvector(j, VecF);
+
+    // extended precision modular arithmetic
+    x = ((x - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+
+    signSin ^= (j & 4) << 29;
+    VecI signCos = (~(j - 2) & 4) << 29;
+    VecI polyMask = (j & 2) == 0;
+
+    VecF z = x * x;
+    VecF cosPoly = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z
+                    + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    VecF sinPoly = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z
+                    - 1.6666654611e-1f) * z * x + x;
+
+    VecF ys = polyMask ? sinPoly : cosPoly;
+    VecF yc = polyMask ? cosPoly : sinPoly;
+
+    s = (VecF)((VecI)ys ^ signSin);
+    c = (VecF)((VecI)yc ^ signCos);
+}
+
+/* Sine and cosine of every lane of a double vector using the Cephes
+   double precision polynomials, in the same way as the float version.
+   The relative error is about 2e-16 for |x| < 1e9. */
+inline void vecSinCos(const VecD& angle, VecD& s, VecD& c)
+{
+    const VecL signMask = VecL{} + (long long)(1ULL << 63);
+
+    VecL xBits = (VecL)angle;
+    VecL signSin = xBits & signMask;
+    VecD x = (VecD)(xBits & ~signMask);
+
+    // octant, rounded up to an even value
+    VecL j = __builtin_convertvector(x * 1.27323954473516268615, VecL);
+    j = (j + 1) & ~1LL;
+    VecD y = __builtin_convertvector(j, VecD);
+
+    // extended precision modular arithmetic
+    x = ((x - y * 7.85398125648498535156e-1) - y * 3.77489470793079817668e-8)
+        - y * 2.69515142907905952645e-15;
+
+    signSin ^= (j & 4) << 61;
+    VecL signCos = (~(j - 2) & 4) << 61;
+    VecL polyMask = (j & 2) == 0;
+
+    VecD z = x * x;
+    VecD cosPoly = (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z
+                       - 2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z
+                     - 1.38888888888730564116e-3) * z + 4.16666666666665929218e-2) * z * z
+                   - 0.5 * z + 1.0;
+    VecD sinPoly = (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z
+                       + 2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z
+                     + 8.33333333332211858878e-3) * z - 1.66666666666666307295e-1) * z * x + x;
+
+    VecL ys = (VecL)vecSelect(polyMask, sinPoly, cosPoly);
+    VecL yc = (VecL)vecSelect(polyMask, cosPoly, sinPoly);
+
+    s = (VecD)(ys ^ signSin);
+    c = (VecD)(yc ^ signCos);
+}
+
+/* Natural logarithm of every lane using the Cephes single precision
+   polynomial.  Accurate to about 1 ulp for positive normal arguments;
+   zero, negative and denormal arguments are not handled. */
+inline VecF vecLog(VecF x)
+{
+    // x = m * 2^e with m in [sqrt(0.5), sqrt(2))
+    VecI bits = (VecI)x;
+    VecI e = ((bits >> 23) & 0xff) - 126;
+    VecF m = (VecF)((bits & 0x007fffff) | 0x3f000000);
+    VecI small = m < 0.707106781186547524f;
+    e += small;
+    m = (small ? m + m : m) - 1.0f;
+
+    VecF z = m * m;
+    VecF y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m
+                    + 1.1676998740e-1f) * m - 1.2420140846e-1f) * m
+                  + 1.4249322787e-1f) * m - 1.6668057665e-1f) * m
+                + 2.0000714765e-1f) * m - 2.4999993993e-1f) * m
+             + 3.3333331174e-1f) * m * z;
+
+    VecF fe = __builtin_convertvector(e, VecF);
+    y += -2.12194440e-4f * fe;
+    y += -0.5f * z;
+    return m + y + 0.693359375f * fe;
+}
+
+// square root of every lane; the arguments must not be negative
+inline VecF vecSqrt(VecF x)
+{
+    VecF r;
+    for (int i = 0; i < VEC_LANES; i++)
+        r[i] = __builtin_sqrtf(x[i]);
+    return r;
+}
+
+} // namespace VEC_ISA
+
+#endif // VECMATH_H
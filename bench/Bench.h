@@ -0,0 +1,76 @@
+//
+//  Bench.h
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+/* Benchmarks of the nmrsim building blocks.  Run "nmrbench" for all of
+   them or name the ones wanted on the command line.  Each result is
+   printed as a line of a table as it is measured; "--csv file" also writes
+   them all to a file that "--baseline file" compares a later run against
+   (see main.cpp). */
+
+void noiseBench();
+void gnuplotBench();
+void specBench();
+void synthesisBench();
+void ioBench();
+
+/* One measurement.  The rates are per sample, byte and spectrum of one
+   run; a count of 0 means the rate does not apply. */
+struct BenchResult
+{
+    std::string name;       // benchmark and case, e.g. "synthesis/direct-phasor"
+    std::string params;     // the point of the grid, e.g. "points=4096 lines=100"
+    double seconds;         // best time of one run
+    double samples;         // samples (points, or lines read) per run
+    double bytes;           // bytes made, written or read per run
+    double spectra;         // spectra made per run
+};
+
+// prints result as a line of the table and keeps it for --csv and --baseline
+void benchReport(const BenchResult& result);
+
+// best wall clock time of run, which is called at least twice and for at
+// least benchMinSeconds() in all
+double benchTime(const std::function<void()>& run);
+
+// total run time wanted of each measurement, shorter with --quick
+double benchMinSeconds();
+
+/* Largest points * lines of the synthesis grid: the direct sums beyond it
+   would take minutes a run.  Smaller with --quick. */
+double benchMaxWork();
+
+// threads given to DataGenerator, 1 unless --threads is given
+unsigned benchThreads();
+
+// wall clock seconds since some fixed time
+inline double benchSeconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // BENCH_H
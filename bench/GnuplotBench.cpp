@@ -0,0 +1,80 @@
+//
+//  GnuplotBench.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "Gnuplot.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+/* Writing a 32K point complex FID as a gnuplot file: the ostream << loop
+   used before (real column only, and with the imaginary column added for
+   comparison) against the to_chars text writer and the binary writer. */
+
+static void writeStream(const ComplexfArray& array, std::ostream& os, bool imaginary)
+{
+    for (unsigned iDim0 = 0; iDim0 < array.rows(); iDim0++)
+    {
+        os << array(iDim0).real();
+        if (imaginary)
+            os << ' ' << array(iDim0).imag();
+        os << "\n";
+    }
+    os << std::endl;
+}
+
+template <typename Writer>
+static void time(const char *name, long npoints, Writer writer)
+{
+    const int NREPEATS = 20;
+
+    // to a real file so the stream costs are included
+    const char *fName = "/tmp/nmrbench.gp";
+    double best = HUGE_VAL;
+    long bytes = 0;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        std::ofstream os(fName, std::ios::binary);
+        double start = benchSeconds();
+        writer(os);
+        best = std::min(best, benchSeconds() - start);
+        bytes = long(os.tellp());
+    }
+    std::remove(fName);
+
+    benchReport({std::string("gnuplot/") + name, "points=" + std::to_string(npoints), best,
+                 double(npoints), double(bytes), 1.0});
+}
+
+void gnuplotBench()
+{
+    const long NPOINTS = 32768;
+
+    ComplexfArray fid(NPOINTS);
+    for (long i = 0; i < NPOINTS; i++)
+        fid(i) = std::polar(float(std::exp(-i * 1.0e-4)), float(i * 0.37));
+
+    time("ostream-real", NPOINTS, [&](std::ostream& os) { writeStream(fid, os, false); });
+    time("ostream", NPOINTS, [&](std::ostream& os) { writeStream(fid, os, true); });
+    time("to_chars", NPOINTS, [&](std::ostream& os) { writeGnuplot(fid, os); });
+    time("binary", NPOINTS, [&](std::ostream& os) { writeGnuplotBinary(fid, os); });
+}
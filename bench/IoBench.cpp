@@ -0,0 +1,122 @@
+//
+//  IoBench.cpp
+//  Ranger
+//
+
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "DataGenerator.h"
+#include "ProNmr.h"
+#include "ProNmrMap.h"
+#include "RangerFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Writing spectra to the page cache: a serial ProNmr file written with
+   ProNmr::writeData() one block at a time, the same file written with one
+   ProNmr::writeFile(), the file made through ProNmrMap and a RANGER file
+   written with RangerWriter one spectrum at a time, storing float32,
+   float16, bfloat16 and scaled int32 samples.  Each run writes about
+   TOTAL_BYTES, as many spectra as that takes.  ProNmr files are limited
+   to 16K complex points by the 16 bit si, so only RANGER files go on to
+   the 1M point end of the grid. */
+
+static const long TOTAL_BYTES = 1L << 24;
+static const long MAX_SPECTRA = 1024;
+static const long MAX_PRONMR_POINTS = 16384;
+
+void ioBench()
+{
+    const char *fName = "/tmp/nmrbench.io";
+
+    for (long npoints = 256; npoints <= 1L << 20; npoints *= 16)
+    {
+        const long nspec = std::min(std::max(TOTAL_BYTES / long(npoints * sizeof(Complexf)), 1L),
+                                    MAX_SPECTRA);
+        const long nfloats = 2 * npoints;
+        const std::string params = "points=" + std::to_string(npoints)
+            + " spectra=" + std::to_string(nspec);
+
+        std::vector<float> data(nfloats * nspec);
+        for (long i = 0; i < long(data.size()); i++)
+            data[i] = float(i % 1000) * 1.0e-3f;
+
+        auto report = [&](const char *name, double seconds)
+        {
+            benchReport({std::string("io/") + name, params, seconds, double(npoints * nspec),
+                         double(data.size() * sizeof(float)), double(nspec)});
+        };
+
+        if (npoints <= MAX_PRONMR_POINTS)
+        {
+            ProNmr header;
+            header.si = nfloats;
+            header.td = nfloats;
+            header.nrecs = nspec;
+
+            std::vector<char> name(fName, fName + std::strlen(fName) + 1);
+            double seconds = benchTime([&]()
+            {
+                header.writeParams(fName);
+                for (long i = 0; i < nspec; i++)
+                    if (header.writeData(data.data() + i * nfloats, name.data(), nfloats,
+                                         header.offsets[DAT], i + 1, 1) != 0)
+                        throw std::runtime_error(std::string("Cannot write ") + fName);
+            });
+            report("pronmr-writeData", seconds);
+
+            seconds = benchTime([&]() { header.writeFile(fName, data.data(), nfloats, nspec); });
+            report("pronmr-writeFile", seconds);
+
+            seconds = benchTime([&]()
+            {
+                ProNmrMap map(fName, header, nspec);
+                for (long i = 0; i < nspec; i++)
+                    std::memcpy(map.data(i + 1), data.data() + i * nfloats,
+                                nfloats * sizeof(float));
+            });
+            report("pronmr-map", seconds);
+        }
+
+        // float32 is plain "ranger", the others are converted as they are written
+        const char *storageNames[] = {"ranger", "ranger-float16", "ranger-bfloat16",
+                                      "ranger-int32"};
+        for (RangerFile::Storage storage : {RangerFile::FLOAT32, RangerFile::FLOAT16,
+                                            RangerFile::BFLOAT16, RangerFile::SCALED_INT32})
+        {
+            RangerFile::Params rangerParams = {
+                RangerFile::sampleType(storage, true), uint64_t(npoints), uint32_t(nspec), 0,
+                1.0e-4, 0.0, 100.0e6, 0.0, 1, 1.0e9
+            };
+            double seconds = benchTime([&]()
+            {
+                RangerWriter writer(fName, rangerParams);
+                for (long i = 0; i < nspec; i++)
+                    writer.write(data.data() + i * nfloats);
+                writer.close();
+            });
+            report(storageNames[storage], seconds);
+        }
+    }
+    std::remove(fName);
+}
@@ -0,0 +1,132 @@
+//
+//  NoiseBench.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "DataGenerator.h"
+#include "GaussianNoise.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* Single threaded speed and shape of the Gaussian noise generators: the
+   sum of 20 random() calls used originally, the same sum of 20 Philox
+   uniforms per sample and the bulk Box-Muller of GaussianNoise.  A sum of
+   20 uniforms has the right variance but too few deviates in the tails,
+   which the counts beyond 4 and 5 standard deviations show, with the
+   expected counts in brackets.  Then DataGenerator::gaussianDeviate(),
+   one call per deviate, and DataGenerator::addNoise() over the FID
+   sizes of the grid. */
+
+static const unsigned NLOOPS = 20;
+
+static float cltRandom()
+{
+    const float MAX_RAND = 0xffffffff / 2;
+
+    float fNum = 0.0;
+    for (unsigned iIdx = 0; iIdx < NLOOPS; iIdx++)
+        fNum += float(random()) / MAX_RAND;
+    fNum -= NLOOPS / 2;
+    fNum *= sqrt(12.0 / NLOOPS);
+    return fNum;
+}
+
+static float cltPhilox(const Philox& philox, uint64_t sample)
+{
+    float fNum = 0.0;
+    for (uint32_t iBlock = 0; iBlock < NLOOPS / 4; iBlock++)
+    {
+        Philox::Block block = philox(sample, 0, iBlock);
+        for (unsigned iWord = 0; iWord < 4; iWord++)
+            fNum += Philox::uniform(block.word[iWord]);
+    }
+    fNum -= NLOOPS / 2;
+    fNum *= sqrt(12.0 / NLOOPS);
+    return fNum;
+}
+
+static void report(const char *name, const std::vector<float>& data, double seconds)
+{
+    double sum2 = 0.0, sum4 = 0.0;
+    long beyond4 = 0, beyond5 = 0;
+    for (float x : data)
+    {
+        double x2 = double(x) * x;
+        sum2 += x2;
+        sum4 += x2 * x2;
+        beyond4 += std::fabs(x) > 4.0f;
+        beyond5 += std::fabs(x) > 5.0f;
+    }
+
+    const double n = data.size();
+    const double variance = sum2 / n;
+    benchReport({std::string("noise/") + name, "deviates=" + std::to_string(data.size()),
+                 seconds, n, n * sizeof(float), 0.0});
+    std::printf("    variance %.5f  excess kurtosis %+.4f  >4 sd %ld (%.0f)  >5 sd %ld (%.0f)\n",
+                variance, sum4 / n / (variance * variance) - 3.0,
+                beyond4, n * 6.334e-5, beyond5, n * 5.733e-7);
+}
+
+void noiseBench()
+{
+    const long N = 1L << 24;
+    std::vector<float> data(N);
+
+    double start = benchSeconds();
+    for (long i = 0; i < N; i++)
+        data[i] = cltRandom();
+    report("clt-random", data, benchSeconds() - start);
+
+    Philox philox(1);
+    start = benchSeconds();
+    for (long i = 0; i < N; i++)
+        data[i] = cltPhilox(philox, i);
+    report("clt-philox", data, benchSeconds() - start);
+
+    GaussianNoise noise(1, 0);
+    start = benchSeconds();
+    noise.fill(data.data(), 0, N, 1.0f);
+    report("box-muller", data, benchSeconds() - start);
+
+    DataGenerator generator(DataGenerator::InputSpecs(DataGenerator::NONE, ""));
+    generator.setThreads(benchThreads());
+    for (long npoints = 256; npoints <= 1L << 20; npoints *= 16)
+    {
+        const std::string params = "points=" + std::to_string(npoints);
+        ComplexfArray fid = ComplexfArray::Zero(npoints);
+
+        double seconds = benchTime([&]()
+        {
+            generator.setSpectrum(0);
+            for (long i = 0; i < npoints; i++)
+                fid(i) = Complexf(generator.gaussianDeviate(0.0f, 1.0f),
+                                  generator.gaussianDeviate(0.0f, 1.0f));
+        });
+        benchReport({"noise/gaussianDeviate", params, seconds, double(npoints),
+                     double(npoints * sizeof(Complexf)), 1.0});
+
+        seconds = benchTime([&]() { generator.addNoise(fid, 1.0f); });
+        benchReport({"noise/addNoise", params, seconds, double(npoints),
+                     double(npoints * sizeof(Complexf)), 1.0});
+    }
+}
@@ -0,0 +1,152 @@
+//
+//  SpecBench.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "BinarySpec.h"
+#include "SpecFile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* Loading a line list of a million lines: the fscanf() loop of the old
+   getInputSpecs(), an istream >> loop like the old InputSpecs::read(),
+   SpecFile and BinarySpec.  The files are written once and read from the
+   page cache.  The binary columns are used in place, so that reader only
+   sums them to touch every page. */
+
+// keeps the sums of readBinary() from being optimised away
+static volatile float benchSink;
+
+struct Lines
+{
+    std::vector<float> amplitude, freq, damp, phase;
+};
+
+static size_t readScanf(const char *fName, Lines& lines)
+{
+    FILE *pFile = fopen(fName, "r");
+    float fDwell, fDe;
+    fscanf(pFile, "%f %f", &fDwell, &fDe);
+
+    float a, f, d, p;
+    while (fscanf(pFile, "%f %f %f %f", &a, &f, &d, &p) == 4)
+    {
+        lines.amplitude.push_back(a);
+        lines.freq.push_back(f);
+        lines.damp.push_back(d);
+        lines.phase.push_back(p);
+    }
+    fclose(pFile);
+    return lines.amplitude.size();
+}
+
+static size_t readStream(const char *fName, Lines& lines)
+{
+    std::ifstream is(fName);
+    float dwell, de;
+    is >> dwell >> de;
+
+    float a, f, d, p;
+    while (is >> a >> f >> d >> p)
+    {
+        lines.amplitude.push_back(a);
+        lines.freq.push_back(f);
+        lines.damp.push_back(d);
+        lines.phase.push_back(p);
+    }
+    return lines.amplitude.size();
+}
+
+static size_t readSpecFile(const char *fName, Lines& lines)
+{
+    SpecFile file(fName);
+    file.readFloat("the dwell");
+    file.readFloat("the pre-acquisition delay");
+    return file.readLines(lines.amplitude, lines.freq, lines.damp, lines.phase);
+}
+
+static size_t readBinary(const char *fName, Lines&)
+{
+    BinarySpec spec(fName);
+    float sum = 0.0;
+    for (const float *column : {spec.amplitude(), spec.freq(), spec.damp(), spec.phase()})
+        for (size_t i = 0; i < spec.nLines(); i++)
+            sum += column[i];
+    benchSink = sum;
+    return spec.nLines();
+}
+
+template <typename Reader>
+static void time(const char *name, const char *fName, Reader reader)
+{
+    const int NREPEATS = 3;
+
+    std::ifstream is(fName, std::ios::ate);
+    const long bytes = long(is.tellg());
+
+    double best = HUGE_VAL;
+    size_t nlines = 0;
+    for (int i = 0; i < NREPEATS; i++)
+    {
+        Lines lines;
+        double start = benchSeconds();
+        nlines = reader(fName, lines);
+        best = std::min(best, benchSeconds() - start);
+    }
+
+    benchReport({std::string("spec/") + name, "lines=" + std::to_string(nlines), best,
+                 double(nlines), double(bytes), 0.0});
+}
+
+void specBench()
+{
+    const long NLINES = 1000000;
+    const char *fName = "/tmp/nmrbench.spec";
+    const char *binaryFName = "/tmp/nmrbench.bspec";
+
+    {
+        std::ofstream os(fName);
+        os << "0.0001 0.00005\n";
+        unsigned x = 12345;
+        for (long i = 0; i < NLINES; i++)
+        {
+            x = x * 1664525u + 1013904223u;
+            os << 0.01f + (x >> 8) * 1.0e-7f << ' ' << -5000.0f + (x % 100000) * 0.1f << ' '
+               << -1.0f - (x % 997) * 0.05f << ' ' << (x % 3600) * 0.1f << '\n';
+        }
+    }
+    {
+        Lines lines;
+        readSpecFile(fName, lines);
+        BinarySpec::write(binaryFName, 0, 0.0001, 0.00005, lines.amplitude.size(),
+                          lines.amplitude.data(), lines.freq.data(), lines.damp.data(),
+                          lines.phase.data());
+    }
+
+    time("fscanf", fName, readScanf);
+    time("istream", fName, readStream);
+    time("SpecFile", fName, readSpecFile);
+    time("BinarySpec", binaryFName, readBinary);
+    std::remove(fName);
+    std::remove(binaryFName);
+}
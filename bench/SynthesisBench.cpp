@@ -0,0 +1,140 @@
+//
+//  SynthesisBench.cpp
+//  Ranger
+//
+
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "DataGenerator.h"
+
+#include <string>
+#include <vector>
+
+/* The synthesis kernels over FID sizes of 256 to 1M points and line lists
+   of 1 to 100K lines: addExpDecaySim() called once per line, as the FIDs
+   were made before makeSimFid(), makeSimFid() with the DIRECT engine in
+   PHASOR and TRIGONOMETRIC mode, summed in float and in double, and with
+   the NUFFT engine, and makeSeqFid() and makeSinFid().  The direct sums
+   are skipped where points * lines is past benchMaxWork(); NUFFT covers
+   the whole grid.  Samples are the points of the FID and bytes those of
+   the FID made. */
+
+struct Lines
+{
+    std::vector<float> amplitude, freq, damp, phase;
+};
+
+static const float DWELL = 1.0e-4;
+
+// nlines lines spread over the spectral width of DWELL
+static Lines makeLines(unsigned nlines)
+{
+    Lines lines;
+    unsigned x = 12345;
+    for (unsigned i = 0; i < nlines; i++)
+    {
+        x = x * 1664525u + 1013904223u;
+        lines.amplitude.push_back(0.01f + (x >> 8) * 1.0e-7f);
+        lines.freq.push_back(-5000.0f + (x % 100000) * 0.1f);
+        lines.damp.push_back(-1.0f - (x % 997) * 0.02f);
+        lines.phase.push_back((x % 3600) * 0.1f);
+    }
+    return lines;
+}
+
+void synthesisBench()
+{
+    DataGenerator generator(DataGenerator::InputSpecs(DataGenerator::NONE, ""));
+    generator.setThreads(benchThreads());
+
+    for (long npoints = 256; npoints <= 1L << 20; npoints *= 16)
+    {
+        ComplexfArray fid(npoints);
+        FloatArray realFid(npoints);
+
+        for (unsigned nlines = 1; nlines <= 100000; nlines *= 10)
+        {
+            const Lines lines = makeLines(nlines);
+            const std::string params = "points=" + std::to_string(npoints)
+                + " lines=" + std::to_string(nlines);
+            const bool direct = double(npoints) * nlines <= benchMaxWork();
+
+            auto report = [&](const char *name, double seconds, size_t sampleBytes)
+            {
+                benchReport({std::string("synthesis/") + name, params, seconds, double(npoints),
+                             double(npoints * sampleBytes), 1.0});
+            };
+
+            auto makeSim = [&]()
+            {
+                generator.makeSimFid(fid, nlines, DWELL, lines.amplitude.data(),
+                                     lines.freq.data(), lines.damp.data(), lines.phase.data(),
+                                     0.0f, true);
+            };
+
+            if (direct)
+            {
+                for (DataGenerator::SynthesisMode mode :
+                     {DataGenerator::PHASOR, DataGenerator::TRIGONOMETRIC})
+                {
+                    const bool phasor = mode == DataGenerator::PHASOR;
+                    generator.setSynthesisMode(mode);
+
+                    double seconds = benchTime([&]()
+                    {
+                        for (unsigned i = 0; i < nlines; i++)
+                            generator.addExpDecaySim(fid, DWELL, lines.amplitude[i],
+                                                     lines.freq[i], lines.damp[i],
+                                                     lines.phase[i], 0.0f, i == 0);
+                    });
+                    report(phasor ? "addExpDecaySim-phasor" : "addExpDecaySim-trig", seconds,
+                           sizeof(Complexf));
+
+                    generator.setSynthesisEngine(DataGenerator::DIRECT);
+                    report(phasor ? "direct-phasor" : "direct-trig", benchTime(makeSim),
+                           sizeof(Complexf));
+
+                    generator.setPrecision(DataGenerator::DOUBLE_PRECISION);
+                    report(phasor ? "direct-phasor-double" : "direct-trig-double",
+                           benchTime(makeSim), sizeof(Complexf));
+                    generator.setPrecision(DataGenerator::SINGLE_PRECISION);
+                }
+
+                generator.setSynthesisMode(DataGenerator::PHASOR);
+                double seconds = benchTime([&]()
+                {
+                    generator.makeSeqFid(realFid, nlines, DWELL, lines.amplitude.data(),
+                                         lines.freq.data(), lines.damp.data(),
+                                         lines.phase.data(), 0.0f, true);
+                });
+                report("seq-phasor", seconds, sizeof(Float));
+
+                seconds = benchTime([&]()
+                {
+                    generator.makeSinFid(realFid, nlines, DWELL, lines.amplitude.data(),
+                                         lines.freq.data(), lines.damp.data(),
+                                         lines.phase.data(), 0.0f, true);
+                });
+                report("sin-phasor", seconds, sizeof(Float));
+            }
+
+            generator.setSynthesisEngine(DataGenerator::NUFFT);
+            report("nufft", benchTime(makeSim), sizeof(Complexf));
+        }
+    }
+}
@@ -0,0 +1,44 @@
+QT -= gui
+
+CONFIG += c++17 console thread
+CONFIG -= app_bundle
+
+TARGET = nmrbench
+
+INCLUDEPATH += ..
+INCLUDEPATH += /home/tim/usr/include
+INCLUDEPATH += /home/tim/usr/include/eigen3
+
+LIBS += -L/home/tim/usr/lib
+
+# Same code generation as nmrsim.pro so the figures apply to it; --isa or
+# NMRSIM_ISA measures the kernels of another instruction set.
+QMAKE_CXXFLAGS += -fno-math-errno
+
+SOURCES += \
+        main.cpp \
+        GnuplotBench.cpp \
+        IoBench.cpp \
+        NoiseBench.cpp \
+        SpecBench.cpp \
+        SynthesisBench.cpp \
+        ../BinarySpec.cpp \
+        ../CpuDispatch.cpp \
+        ../DataGenerator.cpp \
+        ../DecayKernel.cpp \
+        ../GaussianNoise.cpp \
+        ../Gnuplot.cpp \
+        ../Instrument.cpp \
+        ../KernelsAvx2.cpp \
+        ../KernelsAvx512.cpp \
+        ../KernelsBaseline.cpp \
+        ../NufftSynth.cpp \
+        ../Parallel.cpp \
+        ../ProNmr.cpp \
+        ../ProNmrMap.cpp \
+        ../RangerFile.cpp \
+        ../SpecFile.cpp \
+        ../nmrsim.cpp
+
+HEADERS += \
+    Bench.h
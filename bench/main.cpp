@@ -0,0 +1,232 @@
+//
+//  main.cpp
+//  Ranger
+//
+
+/* Ranger is an NMR processing program.
+ * Copyright © 2021 Tim Allman
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Bench.h"
+#include "CpuDispatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+/* Usage: nmrbench [options] [benchmark ...]
+     --csv file          write every result to file as CSV
+     --baseline file     compare the times with those of an earlier --csv
+                         file and exit with status 1 if any is slower by
+                         more than the tolerance
+     --tolerance x       fraction by which a time may exceed the baseline,
+                         0.1 by default
+     --threads n         threads given to DataGenerator, 1 by default
+     --quick             a smaller grid and shorter timing, for a smoke test
+     --isa name          instruction set of the kernels (baseline, avx2 or
+                         avx512) in place of NMRSIM_ISA or the widest the
+                         CPU supports
+   The CSV columns are name, params, seconds, ns_per_sample, gb_per_s and
+   spectra_per_s; a rate that does not apply is 0.  Results are matched to
+   the baseline by name and params, and those missing from either are
+   ignored. */
+
+struct Benchmark
+{
+    const char *name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] =
+{
+    {"synthesis", synthesisBench},
+    {"noise", noiseBench},
+    {"io", ioBench},
+    {"gnuplot", gnuplotBench},
+    {"spec", specBench}
+};
+
+static std::vector<BenchResult> results;
+static bool quick = false;
+static unsigned nthreads = 1;
+
+void benchReport(const BenchResult& result)
+{
+    results.push_back(result);
+    std::printf("%-32s %-28s %10.3f ms %10.3f ns/sample %8.3f GB/s %12.1f spectra/s\n",
+                result.name.c_str(), result.params.c_str(), result.seconds * 1.0e3,
+                result.samples > 0 ? result.seconds / result.samples * 1.0e9 : 0.0,
+                result.bytes / result.seconds * 1.0e-9, result.spectra / result.seconds);
+    std::fflush(stdout);
+}
+
+double benchTime(const std::function<void()>& run)
+{
+    double best = HUGE_VAL;
+    double total = 0.0;
+    for (int i = 0; i < 2 || total < benchMinSeconds(); i++)
+    {
+        double start = benchSeconds();
+        run();
+        double seconds = benchSeconds() - start;
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+double benchMinSeconds()
+{
+    return quick ? 0.02 : 0.2;
+}
+
+double benchMaxWork()
+{
+    return quick ? 1 << 22 : 1 << 30;
+}
+
+unsigned benchThreads()
+{
+    return nthreads;
+}
+
+static void writeCsv(const char *fName)
+{
+    std::ofstream os(fName);
+    os << "name,params,seconds,ns_per_sample,gb_per_s,spectra_per_s\n";
+    for (const BenchResult& result : results)
+    {
+        os << result.name << ',' << result.params << ',' << result.seconds << ','
+           << (result.samples > 0 ? result.seconds / result.samples * 1.0e9 : 0.0) << ','
+           << result.bytes / result.seconds * 1.0e-9 << ','
+           << result.spectra / result.seconds << '\n';
+    }
+    if (!os)
+    {
+        std::cerr << "Cannot write " << fName << "\n";
+        std::exit(2);
+    }
+}
+
+// the number of results slower than in the baseline file by more than tolerance
+static int compareBaseline(const char *fName, double tolerance)
+{
+    std::ifstream is(fName);
+    if (!is)
+    {
+        std::cerr << "Cannot read " << fName << "\n";
+        std::exit(2);
+    }
+
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(is, line);
+    while (std::getline(is, line))
+    {
+        std::istringstream fields(line);
+        std::string name, params, seconds;
+        if (std::getline(fields, name, ',') && std::getline(fields, params, ',')
+            && std::getline(fields, seconds, ','))
+            baseline[name + ',' + params] = std::atof(seconds.c_str());
+    }
+
+    int nslower = 0, ncompared = 0;
+    for (const BenchResult& result : results)
+    {
+        auto found = baseline.find(result.name + ',' + result.params);
+        if (found == baseline.end() || found->second <= 0.0)
+            continue;
+
+        ncompared++;
+        double change = result.seconds / found->second - 1.0;
+        if (change > tolerance)
+        {
+            nslower++;
+            std::printf("slower: %-32s %-28s %10.3f ms -> %10.3f ms (%+.1f%%)\n",
+                        result.name.c_str(), result.params.c_str(), found->second * 1.0e3,
+                        result.seconds * 1.0e3, change * 100.0);
+        }
+    }
+    std::printf("%d of %d results slower than %s by more than %.1f%%\n",
+                nslower, ncompared, fName, tolerance * 100.0);
+    return nslower;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *csvFName = 0;
+    const char *baselineFName = 0;
+    const char *isaName = 0;
+    double tolerance = 0.1;
+    std::vector<const char *> wanted;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--csv") == 0 && hasValue)
+            csvFName = argv[++i];
+        else if (std::strcmp(argv[i], "--baseline") == 0 && hasValue)
+            baselineFName = argv[++i];
+        else if (std::strcmp(argv[i], "--tolerance") == 0 && hasValue)
+            tolerance = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+            nthreads = unsigned(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--isa") == 0 && hasValue)
+            isaName = argv[++i];
+        else if (std::strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else
+            wanted.push_back(argv[i]);
+    }
+
+    try
+    {
+        CpuDispatch::setupFromEnvironment();
+        if (isaName != 0)
+            CpuDispatch::select(CpuDispatch::isa(isaName));
+    }
+    catch (std::invalid_argument& error)
+    {
+        std::cerr << error.what() << "\n";
+        std::exit(2);
+    }
+    std::cout << CpuDispatch::description() << std::endl;
+
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        bool run = wanted.empty();
+        for (const char *name : wanted)
+            run = run || std::strcmp(name, benchmark.name) == 0;
+
+        if (run)
+        {
+            std::cout << "*** " << benchmark.name << std::endl;
+            benchmark.run();
+        }
+    }
+
+    if (csvFName != 0)
+        writeCsv(csvFName);
+    if (baselineFName != 0 && compareBaseline(baselineFName, tolerance) != 0)
+        return 1;
+    return 0;
+}
@@ -19,9 +19,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "CpuDispatch.h"
 #include "DataGenerator.h"
+#include "Instrument.h"
+#include "nmrsim.h"
 
 #include <iostream>
+#include <stdexcept>
 
 //#include <QtCore/QCoreApplication>
 //#include <QtCore/qglobal.h>
@@ -32,23 +36,79 @@ int main(int argc, char *argv[])
 
     std::cout << "nmrsim\n";
 
+    // NMRSIM_PROFILE and NMRSIM_TRACE ask for the run's timings at exit
+    Instrument::setupFromEnvironment();
+
     std::string inpFName;
     std::string outpFNameRoot;
+    std::string noiseFName;
+
+    // convert a spec file between text and binary
+    if (argc == 4 && std::string(argv[1]) == "-c")
+        return convertSpec(argv[2], argv[3]);
+
+    /* The precision of the sums, the storage of the RANGER files, the
+       format of the gnuplot files and the instruction set of the kernels
+       come first.  NMRSIM_ISA can also set the last; -i overrides it. */
+    DataGenerator::Precision precision = DataGenerator::SINGLE_PRECISION;
+    RangerFile::Storage storage = RangerFile::FLOAT32;
+    GnuplotFormat gnuplot = GNUPLOT_TEXT;
+    int arg = 1;
+    try
+    {
+        CpuDispatch::setupFromEnvironment();
+        for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+        {
+            const std::string option = argv[arg], value = argv[arg + 1];
+            if (option == "-p" && (value == "single" || value == "double"))
+                precision = value == "double" ? DataGenerator::DOUBLE_PRECISION
+                                              : DataGenerator::SINGLE_PRECISION;
+            else if (option == "-g" && (value == "text" || value == "binary"))
+                gnuplot = value == "binary" ? GNUPLOT_BINARY : GNUPLOT_TEXT;
+            else if (option == "-s")
+                storage = RangerFile::storage(value);
+            else if (option == "-i")
+                CpuDispatch::select(CpuDispatch::isa(value));
+            else
+                throw std::invalid_argument("Unknown option: " + option + " " + value);
+        }
+    }
+    catch (std::invalid_argument& error)
+    {
+        std::cerr << error.what() << std::endl;
+        exit(1);
+    }
 
-    if (argc == 3)
+    const int nargs = argc - arg;
+    if (nargs == 2 || nargs == 3)
     {
-        inpFName = argv[1];
-        outpFNameRoot = argv[2];
+        inpFName = argv[arg];
+        outpFNameRoot = argv[arg + 1];
+        if (nargs == 3)
+            noiseFName = argv[arg + 2];
     }
     else
     {
-        std::cerr << "Usage: nmrsim infname outfnameroot" << std::endl;
+        std::cerr << "Usage: nmrsim [-p single|double] [-s float32|float16|bfloat16|int32]\n"
+                  << "              [-g text|binary] [-i baseline|avx2|avx512]\n"
+                  << "              infname outfnameroot [noisetable]\n"
+                  << "       nmrsim -c specfname convertedfname\n"
+                  << "-p sets the precision of the sums and -s how the RANGER files store\n"
+                  << "their samples; int32 is scaled to the largest value the FID can reach.\n"
+                  << "-g binary writes the gnuplot files as raw floats (.gpb) for\n"
+                  << "plot 'file' binary format=\"%float%float\" in place of text (.gp).\n"
+                  << "-i, or NMRSIM_ISA, picks the instruction set of the kernels in place of\n"
+                  << "the widest the CPU supports.\n"
+                  << "Set NMRSIM_PROFILE=file (- for stderr) for a JSON summary of the run's\n"
+                  << "timings and counters, and NMRSIM_TRACE=file for a Chrome trace." << std::endl;
         exit(1);
     }
 
-    DataGenerator gen;
+    std::cout << CpuDispatch::description() << std::endl;
 
-    return createData(pInFName, pOutFNameRoot);
+    return createData(inpFName.c_str(), outpFNameRoot.c_str(),
+                      noiseFName.empty() ? 0 : noiseFName.c_str(), precision, storage,
+                      gnuplot);
 
     //return a.exec();
 }
@@ -13,75 +13,115 @@
    and spectra. */
 
 
-#include "gendata.h"
+#include "BinarySpec.h"
+#include "DataGenerator.h"
+#include "Gnuplot.h"
+#include "Instrument.h"
+#include "RangerFile.h"
+#include "SpecFile.h"
 #include "nmrsim.h"
 
+#include <cstdio>
 #include <fstream>
+#include <stdexcept>
 
 using namespace std;
 
+// complex points of the FIDs createData() makes
+static const unsigned NDWELLS = 1024;
+
 bool getInputSpecs(const char *pFName, unsigned &iLines,
-             float &fDwell, float &fDe, float *pAmplitude,
-             float *pFreq, float *pDamp, float *pPhase)
+             float &fDwell, float &fDe, std::vector<float> &Amplitude,
+             std::vector<float> &Freq, std::vector<float> &Damp, std::vector<float> &Phase,
+             std::unique_ptr<BinarySpec> &Binary)
 {
-    FILE *pFile = fopen(pFName, "r");
-
-    if (pFile == 0)
+    ScopedTimer Timer(Instrument::PARSE);
+    Amplitude.clear();
+    Freq.clear();
+    Damp.clear();
+    Phase.clear();
+    Binary.reset();
+    try
     {
-        printf("Could not open file: %s\n", pFName);
-        return false;
-    }
+        // a binary spec file's FID size is not used here
+        if (BinarySpec::isBinary(pFName))
+        {
+            Binary.reset(new BinarySpec(pFName));
+            fDwell = float(Binary->dwell());
+            fDe = float(Binary->preDelay());
+            iLines = unsigned(Binary->nLines());
+            Instrument::count(Instrument::LINES_PROCESSED, iLines);
+            return true;
+        }
 
-    // get the single parameters: dwell then de
-    fscanf(pFile, "%f %f", &fDwell, &fDe);
+        SpecFile File(pFName);
 
-    iLines = 0;
-    while (!feof(pFile))
+        // get the single parameters: dwell then de
+        fDwell = File.readFloat("the dwell");
+        fDe = File.readFloat("the pre-acquisition delay");
+        iLines = unsigned(File.readLines(Amplitude, Freq, Damp, Phase));
+        Instrument::count(Instrument::LINES_PROCESSED, iLines);
+    }
+    catch (std::runtime_error& Error)
     {
-        // check return value to deal with whitespace at end of file
-        if (fscanf(pFile, "%f %f %f %f",
-               &pAmplitude[iLines], &pFreq[iLines], &pDamp[iLines],
-               &pPhase[iLines]) == 4)
-            iLines++;
+        printf("%s\n", Error.what());
+        return false;
     }
 
     return true;
 }
 
-int createData(const char *pInpFName, const char* pOutFNameRoot)
+int convertSpec(const char *pInpFName, const char *pOutFName)
 {
-    std::ofstream os;
-    char pOutFName[200];
-
-    // containers for the data in the file
-    const int MAXLINES = 50;
-    const unsigned NDWELLS = 1024;
-    const float PHASE_0 = 0.0;
-
     unsigned iLines;
     float fDwell;
     float fDe;
-    float pAmplitude[MAXLINES];
-    float pFreq[MAXLINES];
-    float pDamp[MAXLINES];
-    float pPhase[MAXLINES];
+    std::vector<float> Amplitude;
+    std::vector<float> Freq;
+    std::vector<float> Damp;
+    std::vector<float> Phase;
+    std::unique_ptr<BinarySpec> Binary;
+
+    if (getInputSpecs(pInpFName, iLines, fDwell, fDe, Amplitude, Freq, Damp, Phase,
+                      Binary) == false)
+        return 1;
 
-    for (int i = 0; i < MAXLINES; i++)
+    try
     {
-        pAmplitude[i] = -999.0;
-        pFreq[i] = -999.0;
-        pDamp[i] = -999.0;
-        pPhase[i] = -999.0;
+        if (Binary)
+            SpecFile::write(pOutFName, SpecFile::NO_FID_SIZE, fDwell, fDe, iLines,
+                            Binary->amplitude(), Binary->freq(), Binary->damp(),
+                            Binary->phase());
+        else
+            BinarySpec::write(pOutFName, NDWELLS, fDwell, fDe, iLines, Amplitude.data(),
+                              Freq.data(), Damp.data(), Phase.data());
+    }
+    catch (std::runtime_error& Error)
+    {
+        printf("%s\n", Error.what());
+        return 1;
     }
 
-    const unsigned NSPECS = 10;
+    printf("Wrote %s\n", pOutFName);
+    return 0;
+}
 
-    float pNoise[NSPECS] = {
-        0.00, 0.01, 0.02, 0.04, 0.08, 0.16, 0.32, 0.64, 1.28, 2.56
-    };
+int createData(const char *pInpFName, const char* pOutFNameRoot, const char *pNoiseFName,
+               DataGenerator::Precision Precision, RangerFile::Storage Storage,
+               GnuplotFormat Gnuplot)
+{
+    // containers for the data in the file
+    unsigned iLines;
+    float fDwell;
+    float fDe;
+    std::vector<float> Amplitude;
+    std::vector<float> Freq;
+    std::vector<float> Damp;
+    std::vector<float> Phase;
+    std::unique_ptr<BinarySpec> Binary;
 
+    // zeroed by its constructor
     ProNmr Header;
-    memset(&Header, 0, sizeof(ProNmr));
 
     // now fill what we can here
     strcpy(Header.keyname, "\005NMR86");
@@ -106,92 +146,95 @@ int createData(const char *pInpFName, const char* pOutFNameRoot)
     Header.sf1 = 0.0;
     Header.o11= 0.0;
 
-    if (getInputSpecs(pInpFName, iLines, fDwell, fDe, pAmplitude,
-                pFreq, pDamp, pPhase) == false)
-        exit(1);
+    if (getInputSpecs(pInpFName, iLines, fDwell, fDe, Amplitude,
+                Freq, Damp, Phase, Binary) == false)
+        return 1;
+
+    // the columns of a binary spec file are used where they are mapped
+    const float *pAmplitude = Binary ? Binary->amplitude() : Amplitude.data();
+    const float *pFreq = Binary ? Binary->freq() : Freq.data();
+    const float *pDamp = Binary ? Binary->damp() : Damp.data();
+    const float *pPhase = Binary ? Binary->phase() : Phase.data();
 
     printf("Read %d peaks.\n", iLines);
 
-    // make some complex fids
-    ComplexfArray ComplexFid(NDWELLS);
-    for (unsigned iSpec = 0; iSpec < NSPECS; iSpec++)
+    DataGenerator Generator(DataGenerator::InputSpecs(DataGenerator::PRONMR, pInpFName));
+    if (pNoiseFName != 0)
+        Generator.setNoiseTable(DataGenerator::readNoiseTable(pNoiseFName));
+    const std::vector<DataGenerator::NoiseLevel>& NoiseTable = Generator.noiseTable();
+    Generator.setPrecision(Precision);
+    Generator.setStorage(Storage);
+
+    // one scale for the int32 samples of every file, whatever its noise
+    const double fScale = Generator.storageScale(NDWELLS, iLines, fDwell, pAmplitude, pDamp,
+                                                 fDe);
+
+    // the noiseless fid is the same for every spectrum so make it once
+    ComplexfArray CleanFid(NDWELLS);
+    Generator.makeSimFid(CleanFid, iLines, fDwell, pAmplitude, pFreq, pDamp, pPhase, fDe,
+                         true);
+
+    /* and add each noise level and replicate to a copy of it, formatting the
+       gnuplot file on the worker threads while earlier spectra are written */
+    auto Format = [&](unsigned, unsigned, const ComplexfArray& ComplexFid,
+                      std::vector<char>& Text)
     {
-        // Generate FID
-        MakeSimFid(ComplexFid, iLines, fDwell, pAmplitude, pFreq, pDamp,
-                    pPhase, PHASE_0, fDe, true);
+        if (Gnuplot == GNUPLOT_BINARY)
+            formatGnuplotBinary(ComplexFid, Text);
+        else
+            formatGnuplot(ComplexFid, Text);
+    };
 
-        // Add the required noise
-        addNoise(ComplexFid, pNoise[iSpec]);
+    /* every file is written by a writer that throws std::runtime_error,
+       which stops the sweep and is reported below */
+    auto Write = [&](unsigned iLevel, unsigned iReplicate, const ComplexfArray& ComplexFid,
+                     const std::vector<char>& Text)
+    {
+        // replicates are numbered only when there are several
+        char pLevel[32];
+        snprintf(pLevel, sizeof(pLevel), "-%3.2f", NoiseTable[iLevel].stdDev);
+        std::string OutBase = std::string("data/") + pOutFNameRoot + pLevel;
+        if (NoiseTable[iLevel].replicates > 1)
+            OutBase += "-" + std::to_string(iReplicate);
 
         // write out as a gnuplot data set
-        sprintf(pOutFName, "data/%s-%3.2f.gp", pOutFNameRoot, pNoise[iSpec]);
-        std::ofstream os(pOutFName);
-        if (!os)
-        {
-            printf("Could not open file: %s\n", pOutFName);
-            return false;
-        }
-
-        writeGnuplot(ComplexFid, os);
-        os.close();
-
-        // stream out so that it can be read later.
-        sprintf(pOutFName, "data/%s-%3.2f", pOutFNameRoot, pNoise[iSpec]);
-        os.open(pOutFName);
-        //ComplexFid.write(os);
-        os << ComplexFid;
-        os.close();
-
-        // now write out as a pronmr file
-        strcat(pOutFName, "p");
-        if (Header.writeParams(pOutFName) != 0)
+        std::string OutFName = OutBase + (Gnuplot == GNUPLOT_BINARY ? ".gpb" : ".gp");
         {
-            exit(1);
+            ScopedTimer Timer(Instrument::WRITE);
+            std::ofstream os(OutFName, std::ios::binary);
+            os.write(Text.data(), Text.size());
+            os.close();
+            if (!os)
+                throw std::runtime_error("Could not write file: " + OutFName);
+            Instrument::count(Instrument::BYTES_WRITTEN, Text.size());
+            Instrument::count(Instrument::SYSCALLS, 3);
         }
 
-        float *pData = reinterpret_cast<float *>(ComplexFid.data());
+        // write out as a RANGER file so that it can be read later.
+        OutFName = OutBase + ".rgr";
+        RangerFile::Params Params = {
+            RangerFile::sampleType(Storage, true), uint64_t(ComplexFid.rows()), 1, 0,
+            fDwell, fDe, Header.sf, Header.o1, Generator.seed(), fScale
+        };
+        RangerWriter Writer(OutFName, Params);
+        Writer.write(reinterpret_cast<const float *>(ComplexFid.data()));
+        Writer.close();
+
+        // now write out as a pronmr file, parameters and data together
+        OutFName = OutBase + "p";
+        const float *pData = reinterpret_cast<const float *>(ComplexFid.data());
         int iNData = ComplexFid.rows() * 2;
-        if (Header.writeData(pData, pOutFName, iNData, Header.offsets[DAT], 1, 1)!= 0)
-        {
-            exit(1);
-        }
-    }
-
-    return 0;
-}
-
-void writeGnuplot(const FloatArray& array, std::ostream& os)
-{
-    // We put out the array as a matrix, ignoring dim2 for the time being.
-    for (unsigned iDim0 = 0; iDim0 < array.rows(); iDim0++)
+        Header.writeFile(OutFName, pData, iNData, 1);
+    };
+    try
     {
-        for (unsigned iDim1 = 0; iDim1 < array.cols(); iDim1++)
-        {
-            // across the rows
-            if (iDim1 != 0)
-                os << ' ';
-            os << array(iDim0, iDim1);
-        }
-        os << "\n";
+        Generator.sweep(CleanFid, Format, Write);
     }
-
-    os << std::endl;
-}
-
-void writeGnuplot(const ComplexfArray& array, std::ostream& os)
-{
-    // We put out the array as a matrix, ignoring dim2 for the time being.
-    for (unsigned iDim0 = 0; iDim0 < array.rows(); iDim0++)
+    catch (std::runtime_error& Error)
     {
-        for (unsigned iDim1 = 0; iDim1 < array.cols(); iDim1++)
-        {
-            // across the rows
-            if (iDim1 != 0)
-                os << ' ';
-            os << array(iDim0, iDim1).real();
-        }
-        os << "\n";
+        printf("%s\n", Error.what());
+        return 1;
     }
 
-    os << std::endl;
+    return 0;
 }
@@ -22,19 +22,44 @@
 #define NMRSIM_H
 
 #include "ProNmr.h"
-#include "gendata.h"
+#include "DataGenerator.h"
+#include "Gnuplot.h"
 
 #include <fstream>
 #include <cstring>
 #include <iosfwd>
+#include <memory>
+#include <vector>
 
+class BinarySpec;
+
+/* Reads dwell and de and then the line list from pFName (see SpecFile),
+   with no limit on the number of lines, into the vectors.  A binary spec
+   file (see BinarySpec) is also accepted; it is left mapped in Binary and
+   its columns are used in place, the vectors being left empty.  Prints
+   the error and returns false if the file cannot be read. */
 bool getInputSpecs(const char *pFName, unsigned &iLines,
-             float &fDwell, float &fDe, float *pAmplitude,
-             float *pFreq, float *pDamp, float *pPhase);
+             float &fDwell, float &fDe, std::vector<float> &Amplitude,
+             std::vector<float> &Freq, std::vector<float> &Damp, std::vector<float> &Phase,
+             std::unique_ptr<BinarySpec> &Binary);
 
-int createData(const char *pInpFName, const char* pOutFNameRoot);
+/* Converts a spec file as getInputSpecs() reads it from text to the
+   binary format of BinarySpec, or from binary to text.  The numbers are
+   the same floats either way.  Binary files are given the FID size that
+   createData() makes, which the text has no place for.  Returns 0 if all
+   went well. */
+int convertSpec(const char *pInpFName, const char *pOutFName);
 
-void writeGnuplot(const FloatArray& data, std::ostream& os);
-void writeGnuplot(const ComplexfArray& data, std::ostream& os);
+/* Writes one spectrum for every level and replicate of the noise table,
+   read from pNoiseFName (see DataGenerator::readNoiseTable()) or the
+   default table of DataGenerator if it is null.  The FID is summed in
+   precision and the RANGER files store their samples as storage.  The
+   gnuplot files are text (.gp) or, with GNUPLOT_BINARY, raw floats (.gpb,
+   see Gnuplot.h). */
+int createData(const char *pInpFName, const char* pOutFNameRoot,
+               const char *pNoiseFName = 0,
+               DataGenerator::Precision precision = DataGenerator::SINGLE_PRECISION,
+               RangerFile::Storage storage = RangerFile::FLOAT32,
+               GnuplotFormat gnuplot = GNUPLOT_TEXT);
 
 #endif // NMRSIM_H
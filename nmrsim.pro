@@ -1,6 +1,6 @@
 QT -= gui
 
-CONFIG += c++17 console
+CONFIG += c++17 console thread
 CONFIG -= app_bundle
 
 # You can make your code fail to compile if it uses deprecated APIs.
@@ -8,8 +8,24 @@ CONFIG -= app_bundle
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+        BinarySpec.cpp \
+        CpuDispatch.cpp \
         DataGenerator.cpp \
+        DecayKernel.cpp \
+        GaussianNoise.cpp \
+        Gnuplot.cpp \
+        IncrementalSynth.cpp \
+        Instrument.cpp \
+        JacobianSynth.cpp \
+        KernelsAvx2.cpp \
+        KernelsAvx512.cpp \
+        KernelsBaseline.cpp \
+        NufftSynth.cpp \
+        Parallel.cpp \
         ProNmr.cpp \
+        ProNmrMap.cpp \
+        RangerFile.cpp \
+        SpecFile.cpp \
         main.cpp \
         nmrsim.cpp
 
@@ -18,6 +34,15 @@ INCLUDEPATH += /home/tim/usr/include/eigen3
 
 LIBS += -L/home/tim/usr/lib
 
+# Built for the x86-64 baseline so that one binary runs on every node.  The
+# synthesis, noise and sample conversion kernels are compiled again for AVX2
+# and AVX-512 by KernelsAvx2.cpp and KernelsAvx512.cpp and CpuDispatch picks
+# the widest the CPU supports at startup; do not add -march=native here.
+
+# Lets the vector square root of GaussianNoise compile to one instruction
+# instead of a per lane test for a negative argument.
+QMAKE_CXXFLAGS += -fno-math-errno
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -27,6 +52,27 @@ DISTFILES += \
     Notes.txt
 
 HEADERS += \
+    BinarySpec.h \
+    CpuDispatch.h \
     DataGenerator.h \
+    DecayKernel.h \
+    DecayKernelSums.h \
+    GaussianNoise.h \
+    GaussianNoiseDeviates.h \
+    Gnuplot.h \
+    IncrementalSynth.h \
+    Instrument.h \
+    JacobianSynth.h \
+    Kernels.h \
+    LittleEndian.h \
+    NufftSynth.h \
+    Parallel.h \
+    Philox.h \
     ProNmr.h \
-    nmrsim.h
+    ProNmrMap.h \
+    RangerFile.h \
+    SampleFormat.h \
+    SampleFormatVectors.h \
+    SpecFile.h \
+    nmrsim.h \
+    VecMath.h
@@ -0,0 +1,64 @@
+QT -= gui
+
+TEMPLATE = lib
+CONFIG += c++17 staticlib thread
+
+# The generator without main.cpp, for programs such as fitting code that
+# make FIDs in their own memory with DataGenerator::makeFid() instead of
+# reading back the files of nmrsim.  Link libnmrsimlib.a and put this
+# directory and Eigen on the include path.
+TARGET = nmrsimlib
+
+SOURCES += \
+        BinarySpec.cpp \
+        CpuDispatch.cpp \
+        DataGenerator.cpp \
+        DecayKernel.cpp \
+        GaussianNoise.cpp \
+        Gnuplot.cpp \
+        IncrementalSynth.cpp \
+        Instrument.cpp \
+        JacobianSynth.cpp \
+        KernelsAvx2.cpp \
+        KernelsAvx512.cpp \
+        KernelsBaseline.cpp \
+        NufftSynth.cpp \
+        Parallel.cpp \
+        ProNmr.cpp \
+        ProNmrMap.cpp \
+        RangerFile.cpp \
+        SpecFile.cpp \
+        nmrsim.cpp
+
+INCLUDEPATH += /home/tim/usr/include
+INCLUDEPATH += /home/tim/usr/include/eigen3
+
+# The same code generation as nmrsim.pro: the x86-64 baseline, with the
+# kernels chosen at startup by CpuDispatch.
+QMAKE_CXXFLAGS += -fno-math-errno
+
+HEADERS += \
+    BinarySpec.h \
+    CpuDispatch.h \
+    DataGenerator.h \
+    DecayKernel.h \
+    DecayKernelSums.h \
+    GaussianNoise.h \
+    GaussianNoiseDeviates.h \
+    Gnuplot.h \
+    IncrementalSynth.h \
+    Instrument.h \
+    JacobianSynth.h \
+    Kernels.h \
+    LittleEndian.h \
+    NufftSynth.h \
+    Parallel.h \
+    Philox.h \
+    ProNmr.h \
+    ProNmrMap.h \
+    RangerFile.h \
+    SampleFormat.h \
+    SampleFormatVectors.h \
+    SpecFile.h \
+    nmrsim.h \
+    VecMath.h